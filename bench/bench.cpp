@@ -0,0 +1,1031 @@
+/**
+ * @file bench.cpp
+ * @brief Benchmarks of the journal core over synthetic books
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Builds
+ *
+ * @details
+ * Built by "waf bench" over the journal core, natively or for Windows, outside of the game:
+ *
+ *     sse-journal-bench --pages 1000 --size 40000 --format csv > 1.5.0.csv
+ *
+ * A book is generated from a fixed seed, so runs with the same options measure the same work and
+ * their outputs can be compared between versions. Each case is repeated --runs times; minimum,
+ * median, mean and maximum are reported in milliseconds, as JSON (default) or as CSV, with the
+ * heap allocations the last run made on the measuring thread, and the peak resident bytes of the
+ * peak_load runs. The exit code is 1 if any case failed, as does the SAX peak_load of a book of
+ * 1 MB or more when it is not below the DOM one (for a smaller one it is only noted on stderr).
+ *
+ * Options:
+ *   --pages N      pages in the book (1000)
+ *   --size N       content bytes per page (40000)
+ *   --utf8 R       share of the words which are not ASCII, from 0 to 1 (0.1)
+ *   --images N     distinct image files, each 4th page refers one of them (16)
+ *   --seed N       of the generator (1)
+ *   --runs N       repetitions of each case (5)
+ *   --dir PATH     where to write the book files, removed at the end (current directory)
+ *   --format F     json or csv
+ *   --generate F   only write the generated book to file F (any supported extension) and exit
+ *   --peak-load W  only load the book given by --book, through the SAX reader (W is sax) or
+ *                  the nlohmann::json DOM (dom), then print the milliseconds it took and the peak
+ *                  resident bytes of the process, once the search index is built, and exit. The
+ *                  peak_load case runs so itself.
+ */
+
+#include "sse-journal.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wformat="
+#  pragma GCC diagnostic ignored "-Wformat-extra-args"
+#  include <nlohmann/json.hpp>
+#  pragma GCC diagnostic pop
+#endif
+
+#ifdef _WIN32
+#  define NOMINMAX
+#  include <windows.h>
+#  include <psapi.h>
+#  define popen _popen
+#  define pclose _pclose
+#else
+#  include <sys/resource.h>
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+struct options_t
+{
+    unsigned pages = 1000;
+    unsigned size = 40000;
+    double utf8 = .1;
+    unsigned images = 16;
+    unsigned seed = 1;
+    unsigned runs = 5;
+    std::string dir;
+    std::string format = "json";
+    std::string generate;
+    std::string peak_load, book;
+    std::string self;       ///< This program, run again for each peak_load measure
+};
+
+struct result_t
+{
+    std::string name, variant;
+    std::size_t bytes;      ///< Input or output size, if it makes sense
+    std::vector<double> ms;
+    bool ok;
+    std::size_t allocations = 0;    ///< Of the last run
+    std::size_t peak_rss = 0;       ///< Resident bytes of a process only doing this, if measured
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Counted per thread, so the workers running meanwhile do not add to the measured ones
+static thread_local std::size_t allocations = 0;
+
+void*
+operator new (std::size_t n)
+{
+    ++allocations;
+    if (auto p = std::malloc (n ? n : 1))
+        return p;
+    throw std::bad_alloc ();
+}
+
+// Not inlined, or GCC takes the free () for one of a pointer which operator new did not malloc ()
+[[gnu::noinline]] void
+operator delete (void* p) noexcept
+{
+    std::free (p);
+}
+
+[[gnu::noinline]] void
+operator delete (void* p, std::size_t) noexcept
+{
+    std::free (p);
+}
+
+/// Put at the end of the last page, so the search goes through the whole book
+static const std::string needle = "@bench-needle@";
+
+//--------------------------------------------------------------------------------------------------
+
+/// Outside of the game there are no textures, each file gets a distinct dummy, never dereferenced
+
+static int SSEIMGUI_CCONV
+dummy_texture (const char*, void*, void* view)
+{
+    static std::uintptr_t next = 0;
+    next += 16;
+    *reinterpret_cast<ID3D11ShaderResourceView**> (view)
+        = reinterpret_cast<ID3D11ShaderResourceView*> (next);
+    return 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Words to be picked from, some spanning multiple bytes in UTF-8
+
+static const std::vector<std::string> ascii_words = {
+    "the", "dragon", "of", "Whiterun", "and", "a", "sweetroll", "arrow", "in", "knee", "Jarl",
+    "guard", "road", "to", "Riften", "was", "long", "cold", "I", "met", "an", "old", "man",
+    "who", "told", "me", "about", "Shouts", "Greybeards", "mountain", "snow", "night", "fire"
+};
+
+static const std::vector<std::string> utf8_words = {
+    "Довакин", "дракон", "Скайрим", "Übung", "Straße", "δράκος", "ドラゴン", "龍", "旅行者",
+    "용", "naïve", "café", "Ælfric"
+};
+
+static std::string
+random_text (std::mt19937& rng, std::size_t bytes, double utf8)
+{
+    std::uniform_real_distribution<double> share (0, 1);
+    std::uniform_int_distribution<std::size_t> ascii (0, ascii_words.size () - 1);
+    std::uniform_int_distribution<std::size_t> wide (0, utf8_words.size () - 1);
+    std::uniform_int_distribution<int> line (0, 15);
+
+    std::string s;
+    s.reserve (bytes + 32);
+    while (s.size () < bytes)
+    {
+        auto const& w = share (rng) < utf8 ? utf8_words[wide (rng)] : ascii_words[ascii (rng)];
+        if (s.size () + w.size () + 1 > bytes)
+            break;
+        s += w;
+        s += line (rng) ? ' ' : '\n';
+    }
+    return s;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+generate_book (options_t const& opt)
+{
+    std::mt19937 rng (opt.seed);
+
+    std::vector<page_t> pages (std::max (opt.pages, 2u));
+    for (std::size_t i = 0; i < pages.size (); ++i)
+    {
+        auto& p = pages[i];
+        p.title = "Chapter " + std::to_string (i + 1) + ": " + random_text (rng, 24, opt.utf8);
+        p.content = random_text (rng, opt.size, opt.utf8);
+        if (opt.images && i % 4 == 0)
+        {
+            p.image.background = i % 8 == 0;
+            obtain_image (images_directory + "bench" + std::to_string (i / 4 % opt.images)
+                    + ".dds", p.image);
+        }
+    }
+    pages.back ().content += needle;
+
+    journal.pages = std::move (pages);
+    journal.current_page = 0;
+    book_replaced ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static std::string
+xml_escaped (std::string_view s)
+{
+    std::string out;
+    out.reserve (s.size ());
+    for (char c: s)
+        switch (c)
+        {
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '&': out += "&amp;"; break;
+            default: out += c;
+        }
+    return out;
+}
+
+/// The book as exported by the Take Notes mod (through FISS), entries in reverse order
+
+static bool
+write_takenotes (std::string const& file)
+{
+    std::ofstream of (file, std::ios::binary);
+    of << "<fiss>\n<Data>\n<NumberOfEntries>" << journal.pages.size () << "</NumberOfEntries>\n";
+    for (auto i = journal.pages.size (); i > 0; --i)
+    {
+        auto n = std::to_string (i);
+        of << "<date" << n << '>' << xml_escaped (journal.pages[i-1].title)
+           << "</date" << n << ">\n<entry" << n << '>' << xml_escaped (page_content (i-1))
+           << "</entry" << n << ">\n";
+    }
+    of << "</Data>\n</fiss>\n";
+    of.close ();
+    return bool (of);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static std::size_t
+file_size (std::string const& file)
+{
+    std::ifstream fi (file, std::ios::binary | std::ios::ate);
+    return fi.is_open () ? std::size_t (fi.tellg ()) : 0;
+}
+
+/// Runs @p f (returning success) the given times, @p prepare is not measured
+
+template<class F, class P>
+static result_t
+measure (options_t const& opt, std::string name, std::string variant, F&& f, P&& prepare)
+{
+    result_t r { std::move (name), std::move (variant), 0, {}, true };
+    for (unsigned i = 0; i < opt.runs && r.ok; ++i)
+    {
+        prepare ();
+        auto allocated = allocations;
+        auto start = std::chrono::steady_clock::now ();
+        r.ok = f ();
+        std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now () - start;
+        r.allocations = allocations - allocated;
+        r.ms.push_back (d.count ());
+    }
+    std::clog << r.name << ' ' << r.variant << (r.ok ? " done" : " failed") << std::endl;
+    return r;
+}
+
+template<class F>
+static result_t
+measure (options_t const& opt, std::string name, std::string variant, F&& f)
+{
+    return measure (opt, std::move (name), std::move (variant), std::forward<F> (f), [] {});
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The most resident memory of this process so far
+
+static std::size_t
+peak_rss ()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!K32GetProcessMemoryInfo (GetCurrentProcess (), &pmc, sizeof (pmc)))
+        return 0;
+    return pmc.PeakWorkingSetSize;
+#else
+    rusage ru;
+    getrusage (RUSAGE_SELF, &ru);
+    return std::size_t (ru.ru_maxrss) * 1024;
+#endif
+}
+
+/// As the books were loaded before the SAX reader: all the document parsed, then copied out
+
+static bool
+load_book_dom (std::string const& file)
+{
+    std::ifstream fi (file);
+    auto json = nlohmann::json::parse (fi, nullptr, false);
+    if (json.is_discarded () || !json.contains ("pages"))
+        return false;
+    std::vector<page_t> pages;
+    for (auto const& kv: json["pages"].items ())
+    {
+        page_t p {};
+        p.title = kv.value ()["title"].get<std::string> ();
+        p.content = kv.value ()["content"].get<std::string> ();
+        pages.push_back (std::move (p));
+    }
+    journal.pages = std::move (pages);
+    // As load_book does, so both ways build the same index after
+    book_replaced ();
+    return journal.pages.size () >= 2;
+}
+
+/// What the --peak-load option does, in the process run for it
+
+static int
+peak_load (options_t const& opt)
+{
+    auto start = std::chrono::steady_clock::now ();
+    bool ok = opt.peak_load == "dom" ? load_book_dom (opt.book) : load_book (opt.book);
+    std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now () - start;
+    // The index the load starts on the worker takes its memory too
+    while (index_busy ())
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    std::cout << d.count () << ' ' << peak_rss () << std::endl;
+    return ok ? 0 : 1;
+}
+
+/// Smaller books are not failed for the SAX peak_load not taking less than the DOM one
+constexpr std::size_t peak_load_min_bytes = 1 << 20;
+
+/// The peak memory is of the whole process, so each run is a fresh one
+
+static result_t
+measure_peak_load (options_t const& opt, std::string const& way, std::string const& file)
+{
+    result_t r { "peak_load", way, file_size (file), {}, true };
+    auto command = '"' + opt.self + "\" --peak-load " + way + " --book \"" + file + '"';
+    for (unsigned i = 0; i < opt.runs && r.ok; ++i)
+    {
+        double ms = 0;
+        std::size_t peak = 0;
+        auto p = popen (command.c_str (), "r");
+        r.ok = p && std::fscanf (p, "%lf %zu", &ms, &peak) == 2;
+        if (p)
+            r.ok = pclose (p) == 0 && r.ok;
+        r.ms.push_back (ms);
+        r.peak_rss = std::max (r.peak_rss, peak);
+    }
+    std::clog << r.name << ' ' << r.variant << (r.ok ? " done" : " failed") << std::endl;
+    return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The text scanning kernels of each kind the CPU has, over one page many times and over the whole
+/// book once, so both scan the same bytes
+
+static void
+run_kernel_cases (options_t const& opt, std::vector<result_t>& results)
+{
+    std::string book_text;
+    for (std::size_t i = 0; i < journal.pages.size (); ++i)
+        book_text += page_content (i);
+    std::string page_text = std::string (page_content (0));
+    if (page_text.empty ())
+        return;
+    std::size_t repeats = std::max<std::size_t> (1, book_text.size () / page_text.size ());
+    std::string blank_book (book_text.size (), ' '), blank_page (page_text.size (), ' ');
+
+    for (auto kind: { "scalar", "sse2", "avx2" })
+    {
+        if (!use_text_kernels (kind))
+            continue;
+        for (bool page: { true, false })
+        {
+            std::string_view text = page ? page_text : book_text;
+            std::string_view blank = page ? blank_page : blank_book;
+            auto n = page ? repeats : 1;
+            auto variant = std::string (kind) + (page ? " page" : " book");
+            auto run = [&] (const char* name, auto&& f) {
+                results.push_back (measure (opt, name, variant, [&] {
+                    bool ok = true;
+                    for (std::size_t i = 0; i < n; ++i)
+                        ok = f () && ok;
+                    return ok;
+                }));
+                results.back ().bytes = n * text.size ();
+            };
+            run ("find_visible", [&] { return find_visible (blank) == std::string_view::npos; });
+            run ("count_newlines", [&] { return count_newlines (text) < text.size (); });
+            run ("find_text", [&] { return find_text (text, "@bench-missing@") == std::string_view::npos; });
+            run ("find_folded", [&] { return find_folded (text, "@BENCH-missing@") == std::string_view::npos; });
+            run ("valid_utf8", [&] { return valid_utf8 (text); });
+        }
+    }
+    use_text_kernels ({});
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Laid out as the game memory the variables read: globals at some offsets of the image base,
+/// pointing to the objects holding the values, or pointing to the name strings
+
+struct mock_image_t
+{
+    std::uintptr_t unused;      ///< A zero offset means not found
+    std::uintptr_t time_global, player_global;
+    float time[2];              ///< The epoch is the second
+    struct
+    {
+        std::uintptr_t cell, worldspace;
+        float position[3];
+    } player;
+    std::uintptr_t cell[2], worldspace[2];  ///< The name is the second
+};
+
+static mock_image_t mock_image;
+
+static void
+point_to_mock_image ()
+{
+    auto& m = mock_image;
+    m.time_global = reinterpret_cast<std::uintptr_t> (&m.time);
+    m.player_global = reinterpret_cast<std::uintptr_t> (&m.player);
+    m.time[1] = 12.375f;
+    m.player = { reinterpret_cast<std::uintptr_t> (&m.cell),
+                 reinterpret_cast<std::uintptr_t> (&m.worldspace), { 1234.4f, -5678.6f, 90.f } };
+    m.cell[1] = reinterpret_cast<std::uintptr_t> ("Riverwood");
+    m.worldspace[1] = reinterpret_cast<std::uintptr_t> ("Skyrim");
+
+    auto& gm = game_memory;
+    gm.base = reinterpret_cast<std::uintptr_t> (&m);
+    gm.epoch.offsets = { offsetof (mock_image_t, time_global), sizeof (float) };
+    gm.position.offsets = { offsetof (mock_image_t, player_global), 2 * sizeof (std::uintptr_t) };
+    gm.cell.offsets = { offsetof (mock_image_t, player_global), 0, sizeof (std::uintptr_t), 0 };
+    gm.worldspace.offsets = { offsetof (mock_image_t, player_global), sizeof (std::uintptr_t),
+                              sizeof (std::uintptr_t), 0 };
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static std::vector<result_t>
+run_cases (options_t const& opt)
+{
+    std::vector<result_t> results;
+    auto book = [&opt] (const char* ext) { return opt.dir + "bench-book" + ext; };
+    auto regenerate = [&opt] { generate_book (opt); };
+
+    generate_book (opt);
+
+    // Saving the same book to each format, the last one of each stays for loading
+    for (auto ext: { ".json", ".jbook", ".cbor", ".msgpack" })
+    {
+        auto file = book (ext);
+        results.push_back (measure (opt, "save_book", ext + 1, [&file] {
+            return save_book (file);
+        }));
+        results.back ().bytes = file_size (file);
+    }
+    results.push_back (measure (opt, "save_book", "json compact", [&book] {
+        return save_book (book (".compact.json"), json_writer::style::compact);
+    }));
+    results.back ().bytes = file_size (book (".compact.json"));
+    results.push_back (measure (opt, "save_text", "txt", [&book] {
+        return save_text (book (".txt"));
+    }));
+    results.back ().bytes = file_size (book (".txt"));
+
+    // The JSON book in a fresh process each way, for the memory it takes. Taking no less than the
+    // DOM would defeat the point of the SAX reader, so that fails the case, unless the book is too
+    // small for the reader to matter next to the rest of the process.
+    auto sax = measure_peak_load (opt, "sax", book (".json"));
+    auto dom = measure_peak_load (opt, "dom", book (".json"));
+    if (sax.ok && dom.ok && sax.peak_rss >= dom.peak_rss)
+    {
+        std::clog << "peak_load sax takes " << sax.peak_rss << " bytes, not less than the "
+                  << dom.peak_rss << " bytes of dom" << std::endl;
+        sax.ok = sax.bytes < peak_load_min_bytes;
+    }
+    results.push_back (std::move (sax));
+    results.push_back (std::move (dom));
+
+    auto takenotes = book (".xml");
+    bool xml_ok = write_takenotes (takenotes);
+
+    for (auto ext: { ".json", ".jbook", ".cbor", ".msgpack" })
+    {
+        auto file = book (ext);
+        results.push_back (measure (opt, "load_book", ext + 1, [&file] {
+            return load_book (file);
+        }));
+        results.back ().bytes = file_size (file);
+    }
+
+    // The binary book is loaded lazily, this is what it takes to load each page later
+    results.push_back (measure (opt, "touch_page", "jbook", [] {
+        for (std::size_t i = 0; i < journal.pages.size (); ++i)
+            touch_page (i);
+        return true;
+    }, [&book] { load_book (book (".jbook")); }));
+
+    // Searching in the mapped book, with no page loaded
+    load_book (book (".jbook"));
+    // Until the worker is done, the finds meanwhile scan the pages
+    results.push_back (measure (opt, "index_pages", "jbook", [] {
+        index_pages ();
+        while (index_busy ())
+            std::this_thread::yield ();
+        return true;
+    }));
+    results.push_back (measure (opt, "find_page", "jbook", [] {
+        return find_page (needle) + 1 == journal.pages.size ();
+    }));
+
+    results.push_back (measure (opt, "load_takenotes", "xml", [&takenotes, xml_ok] {
+        return xml_ok && load_takenotes (takenotes);
+    }));
+    results.back ().bytes = file_size (takenotes);
+
+    // Take Notes journals of many short entries, as kept over a long play
+    for (unsigned entries: { 10000u, 100000u })
+    {
+        options_t notes = opt;
+        notes.pages = entries;
+        notes.size = 200;
+        notes.images = 0;
+        generate_book (notes);
+        bool ok = write_takenotes (takenotes);
+        results.push_back (measure (opt, "load_takenotes", std::to_string (entries) + " entries",
+                [&takenotes, ok, entries] {
+            return ok && load_takenotes (takenotes) && journal.pages.size () == entries;
+        }));
+        results.back ().bytes = file_size (takenotes);
+    }
+
+    regenerate ();
+    while (index_busy ())
+        std::this_thread::yield ();
+
+    // The Load window refreshes, over the books saved above
+    books_directory = opt.dir.empty () ? "./" : opt.dir;
+    // Not a book extension, or it would be indexed too
+    library_location = opt.dir + "bench-book.library";
+    auto refresh_library = [] {
+        refresh_library_async ();
+        while (library_busy ())
+            std::this_thread::yield ();
+        return library_books () >= 5;
+    };
+    results.push_back (measure (opt, "refresh_library", "all changed", refresh_library,
+            [&book, &takenotes] {
+        for (auto ext: { ".json", ".jbook", ".cbor", ".msgpack" })
+            save_book (book (ext));
+        write_takenotes (takenotes);
+    }));
+    results.push_back (measure (opt, "refresh_library", "one changed", refresh_library,
+            [&book] { save_book (book (".json")); }));
+    results.push_back (measure (opt, "refresh_library", "unchanged", refresh_library));
+    results.back ().bytes = file_size (library_location);
+    results.push_back (measure (opt, "library_search", "two words", [] {
+        return !library_search ("whiterun sweet").empty ();
+    }));
+
+    results.push_back (measure (opt, "find_page", "last page", [] {
+        return find_page (needle) + 1 == journal.pages.size ();
+    }));
+    // The edited page is scanned, and handed to the worker to be indexed again
+    results.push_back (measure (opt, "find_page", "edited", [] {
+        page_edited (journal.pages.size () / 2);
+        return find_page (needle) + 1 == journal.pages.size ();
+    }));
+    results.push_back (measure (opt, "find_page", "missing", [] {
+        return find_page ("@bench-missing@") == journal.pages.size ();
+    }));
+    // Until the worker is done, as the Search window would wait for it
+    results.push_back (measure (opt, "search", "two words", [] {
+        std::vector<search_hit_t> hits;
+        search_async ("whiterun SWEETROLL");
+        while (!take_search_results (hits))
+            std::this_thread::yield ();
+        return !hits.empty ();
+    }));
+
+    // What the Chapters window asks for each frame, while a page is being typed in
+    results.push_back (measure (opt, "chapter_list", "edited", [] {
+        page_edited (journal.pages.size () / 2);
+        return chapter_list ().size () == journal.pages.size ();
+    }));
+    results.push_back (measure (opt, "chapter_list", "filtered", [] {
+        page_edited (journal.pages.size () / 2);
+        return chapter_list ("the").size () <= journal.pages.size ();
+    }));
+
+    std::size_t content = 0;
+    for (auto const& p: journal.pages)
+        content += p.content.size ();
+    results.push_back (measure (opt, "greedy_word_wrap", "60", [] {
+        std::size_t n = 0;
+        for (auto const& p: journal.pages)
+            n += greedy_word_wrap (p.content, 60).size ();
+        return n > 0;
+    }));
+    results.back ().bytes = content;
+
+    // Once per page flip or edit, the reading afterwards costs only the visible lines. A font with
+    // the Latin-1 glyphs, rest falling back, is close enough to the game ones.
+    std::vector<float> advances (256, 7.f);
+    ImFont font {};
+    font.IndexAdvanceX = ImVector_float { int (advances.size ()), int (advances.size ()),
+                                          advances.data () };
+    font.FallbackAdvanceX = 9.f;
+    font.FontSize = 18.f;
+    results.push_back (measure (opt, "layout_text", "page", [&font] {
+        text_layout_t layout;
+        std::size_t n = 0;
+        for (auto const& p: journal.pages)
+        {
+            layout_text (layout, p.content, font, 18.f, 330.f);
+            n += layout.starts.size ();
+        }
+        return n >= journal.pages.size ();
+    }));
+    results.back ().bytes = content;
+
+    // What the instrumented sections pay, a frame having a few dozen of them
+    constexpr int scopes = 100000;
+    for (bool traced: { false, true })
+    {
+        enable_tracing (traced);
+        results.push_back (measure (opt, "profile_scope", traced ? "tracing" : "disabled", [] {
+            for (int i = 0; i < scopes; ++i)
+            {
+                profile_scope scope ("bench");
+                scope.arg ("i", std::uint64_t (i));
+            }
+            return true;
+        }, [traced] { enable_tracing (false); enable_tracing (traced); }));
+    }
+    results.push_back (measure (opt, "write_trace", "scopes", [&opt] {
+        return write_trace (opt.dir + "bench.trace.json");
+    }));
+    results.back ().bytes = file_size (opt.dir + "bench.trace.json");
+    enable_tracing (false);
+
+    // What the caller pays, the writer thread catching up in between the runs
+    open_logfile (opt.dir + "bench.log");
+    constexpr int log_lines = 512;
+    results.push_back (measure (opt, "log", "lines", [] {
+        for (int i = 0; i < log_lines; ++i)
+            log (log_level::warning) << "Less than two pages. Inserting empty one " << i << '.'
+                                     << std::endl;
+        return true;
+    }, [] { flush_log (); }));
+    results.push_back (measure (opt, "log", "below threshold", [] {
+        for (int i = 0; i < log_lines; ++i)
+            log (log_level::debug) << "Less than two pages. Inserting empty one " << i << '.'
+                                   << std::endl;
+        return true;
+    }));
+    flush_log ();
+
+    run_kernel_cases (opt, results);
+
+    // As the Append left/right buttons do, one variable output at a time
+    results.push_back (measure (opt, "append_page", "variable output", [] {
+        page_text text;
+        for (int i = 0; i < 100000; ++i)
+            text += "12:30 AM, 17th of Last Seed\n";
+        return text.size () == 100000 * 28;
+    }));
+
+    // Other mods posting from their threads at once, then the render thread draining them all.
+    // None may get lost, as long as the queue has room.
+    results.push_back (measure (opt, "commands", "4 threads append", [] {
+        constexpr int per_thread = 32;
+        std::vector<std::thread> posters;
+        for (int t = 0; t < 4; ++t)
+            posters.emplace_back ([] {
+                for (int i = 0; i < per_thread; ++i)
+                    post_command (command_kind::append, "\n12:30 AM, 17th of Last Seed\n");
+            });
+        for (auto& t: posters)
+            t.join ();
+        auto before = page_content (journal.pages.size () - 1).size ();
+        run_commands (4 * per_thread);
+        auto after = page_content (journal.pages.size () - 1).size ();
+        return after - before == 4 * per_thread * 28;
+    }));
+
+    // What the variables give, minus reading the game memory
+    constexpr int evaluations = 10000;
+    results.push_back (measure (opt, "game_time", "default", [] {
+        std::size_t n = 0;
+        for (int i = 0; i < evaluations; ++i)
+            n += game_time ("%h:%m %ld, day %md of %lm, %Y", 12.375f + i).size ();
+        return n > 0;
+    }));
+    // As the Game time variable evaluates, the format compiled once and the output reused
+    results.push_back (measure (opt, "game_time", "compiled", [] {
+        static format_program program;
+        static std::string out;
+        compile_game_time (program, "%h:%m %ld, day %md of %lm, %Y");
+        std::size_t n = 0;
+        for (int i = 0; i < evaluations; ++i)
+        {
+            game_time (out, program, 12.375f + i);
+            n += out.size ();
+        }
+        return n > 0;
+    }));
+    // Once per frame for all variables, and what the Player position variable makes of it
+    point_to_mock_image ();
+    results.push_back (measure (opt, "game_state", "refresh", [] {
+        bool ok = true;
+        for (int i = 0; i < evaluations; ++i)
+        {
+            tick_game_state ();
+            auto const& gs = game_state ();
+            ok = ok && gs.has_epoch && gs.epoch == 12.375f && gs.position[2] == 90.f
+                    && gs.cell == "Riverwood" && gs.worldspace == "Skyrim";
+        }
+        return ok;
+    }));
+    results.push_back (measure (opt, "player_location", "compiled", [] {
+        static format_program program;
+        static std::string out;
+        compile_player_location (program, "%wn, %cn: %x %y %z (%cx, %cy)");
+        for (int i = 0; i < evaluations; ++i)
+        {
+            tick_game_state ();
+            player_location (out, program, game_state ());
+        }
+        return out == "Skyrim, Riverwood: 1234 -5679 90 (0, -2)";
+    }));
+    // As in the Main Menu: the player not there yet, or half built
+    results.push_back (measure (opt, "game_state", "broken chain", [] {
+        format_program program;
+        compile_player_location (program, "%x %y %z");
+        std::string out;
+        bool ok = true;
+        for (std::uintptr_t bad: { std::uintptr_t (0), std::uintptr_t (8),
+                                   reinterpret_cast<std::uintptr_t> (&mock_image.player) + 1 })
+        {
+            mock_image.player_global = bad;
+            tick_game_state ();
+            auto const& gs = game_state ();
+            player_location (out, program, gs);
+            ok = ok && gs.has_epoch && !gs.has_position && gs.cell.empty () && out == "(n/a)";
+        }
+        return ok;
+    }, [] { point_to_mock_image (); }));
+
+    // A page full of placeholders of one variable, the game time changing as the view sees it:
+    // each frame, but within the minute, then one minute per frame
+    point_to_mock_image ();
+    variable_t gtime;
+    gtime.name = "Game time";
+    gtime.params = "%h:%m";
+    gtime.apply = [] (variable_t* self) {
+        compile_game_time (self->program, self->params);
+        game_time (self->output, self->program, game_state ().epoch);
+    };
+    gtime.inputs = [] (variable_t* self, std::string& key) {
+        compile_game_time (self->program, self->params);
+        game_time_inputs (key, self->program, game_state ().epoch);
+    };
+    auto variables = std::move (journal.variables);
+    journal.variables.clear ();
+    journal.variables.push_back (std::move (gtime));
+    static std::string placeholders_page;
+    placeholders_page.clear ();
+    for (int i = 0; i < 500; ++i)
+        placeholders_page += "At {{Game time}}, nothing to note.\n";
+
+    constexpr int frames = 1000;
+    results.push_back (measure (opt, "placeholders", "same minute", [] {
+        static std::string expanded;
+        unsigned seen = 0, expansions = 0;
+        for (int i = 0; i < frames; ++i)
+        {
+            mock_image.time[1] = 12.375f + (i % 8) * 1e-5f;
+            tick_game_state ();
+            if (placeholders_revision () != seen)
+            {
+                expand_placeholders (expanded, placeholders_page);
+                seen = placeholders_revision ();
+                ++expansions;
+            }
+        }
+        return expansions == 1 && expanded.find ("At 9:0, nothing") == 0;
+    }));
+    results.push_back (measure (opt, "placeholders", "each minute", [] {
+        static std::string expanded;
+        unsigned seen = 0, expansions = 0;
+        for (int i = 0; i < frames; ++i)
+        {
+            mock_image.time[1] = 12.375f + (i + .5f) / (24 * 60);
+            tick_game_state ();
+            if (placeholders_revision () != seen)
+            {
+                expand_placeholders (expanded, placeholders_page);
+                seen = placeholders_revision ();
+                ++expansions;
+            }
+        }
+        auto shown = "At " + game_time ("%h:%m", mock_image.time[1]) + ", nothing to note.\n";
+        return expansions == frames && expanded.size () == 500 * shown.size ()
+            && expanded.starts_with (shown);
+    }));
+    results.push_back (measure (opt, "placeholders", "freeze", [] {
+        auto last = journal.pages.size () - 1;
+        return freeze_placeholders () == 1
+            && page_content (last).find ("{{") == std::string_view::npos;
+    }, [] {
+        auto last = journal.pages.size () - 1;
+        touch_page (last).content = std::string_view (placeholders_page);
+        page_edited (last);
+    }));
+    journal.variables = std::move (variables);
+    game_memory = {};
+
+    results.push_back (measure (opt, "local_time", "default", [] {
+        std::size_t n = 0;
+        for (int i = 0; i < evaluations; ++i)
+            n += local_time ("%X %x").size ();
+        return n > 0;
+    }));
+
+    for (auto ext: { ".json", ".jbook", ".cbor", ".msgpack", ".compact.json", ".txt", ".xml" })
+        std::remove (book (ext).c_str ());
+    std::remove (library_location.c_str ());
+    return results;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+struct summary_t
+{
+    double min, median, mean, max;
+};
+
+static summary_t
+summarize (std::vector<double> ms)
+{
+    if (ms.empty ())
+        return {};
+    std::sort (ms.begin (), ms.end ());
+    auto n = ms.size ();
+    return summary_t {
+        ms.front (),
+        n % 2 ? ms[n/2] : (ms[n/2-1] + ms[n/2]) / 2,
+        std::accumulate (ms.begin (), ms.end (), 0.) / n,
+        ms.back ()
+    };
+}
+
+static std::string
+version_string ()
+{
+    int maj, min, patch;
+    journal_version (&maj, &min, &patch, nullptr);
+    return std::to_string (maj) + '.' + std::to_string (min) + '.' + std::to_string (patch);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+print_json (options_t const& opt, std::vector<result_t> const& results)
+{
+    const char* timestamp;
+    journal_version (nullptr, nullptr, nullptr, &timestamp);
+
+    json_writer json (std::cout);
+    json.begin_object ()
+        .key ("version").value (version_string ())
+        .key ("timestamp").value (timestamp)
+        .key ("book").begin_object ()
+            .key ("pages").value (opt.pages)
+            .key ("size").value (opt.size)
+            .key ("utf8").value (opt.utf8)
+            .key ("images").value (opt.images)
+            .key ("seed").value (opt.seed)
+        .end_object ()
+        .key ("runs").value (opt.runs)
+        .key ("results").begin_array ();
+    for (auto const& r: results)
+    {
+        auto s = summarize (r.ms);
+        json.begin_object ()
+            .key ("name").value (r.name)
+            .key ("variant").value (r.variant)
+            .key ("ok").value (r.ok)
+            .key ("bytes").value (r.bytes)
+            .key ("min_ms").value (s.min)
+            .key ("median_ms").value (s.median)
+            .key ("mean_ms").value (s.mean)
+            .key ("max_ms").value (s.max)
+            .key ("allocations").value (r.allocations)
+            .key ("peak_rss").value (r.peak_rss)
+            .end_object ();
+    }
+    json.end_array ()
+        .end_object ();
+    json.flush ();
+    std::cout << std::endl;
+}
+
+static void
+print_csv (options_t const& opt, std::vector<result_t> const& results)
+{
+    auto version = version_string ();
+    std::cout << "version,pages,size,utf8,images,runs,name,variant,ok,bytes,"
+                 "min_ms,median_ms,mean_ms,max_ms,allocations,peak_rss\n";
+    for (auto const& r: results)
+    {
+        auto s = summarize (r.ms);
+        std::cout << version << ',' << opt.pages << ',' << opt.size << ',' << opt.utf8 << ','
+                  << opt.images << ',' << opt.runs << ',' << r.name << ",\"" << r.variant << "\","
+                  << r.ok << ',' << r.bytes << ',' << s.min << ',' << s.median << ','
+                  << s.mean << ',' << s.max << ',' << r.allocations << ',' << r.peak_rss << '\n';
+    }
+    std::cout << std::flush;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static bool
+parse_options (int argc, char** argv, options_t& opt)
+{
+    for (int i = 1; i < argc; i += 2)
+    {
+        std::string key = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value of " << key << std::endl;
+            return false;
+        }
+        std::string value = argv[i+1];
+        try
+        {
+            if (key == "--pages") opt.pages = std::stoul (value);
+            else if (key == "--size") opt.size = std::stoul (value);
+            else if (key == "--utf8") opt.utf8 = std::stod (value);
+            else if (key == "--images") opt.images = std::stoul (value);
+            else if (key == "--seed") opt.seed = std::stoul (value);
+            else if (key == "--runs") opt.runs = std::max (1ul, std::stoul (value));
+            else if (key == "--format") opt.format = value;
+            else if (key == "--generate") opt.generate = value;
+            else if (key == "--peak-load") opt.peak_load = value;
+            else if (key == "--book") opt.book = value;
+            else if (key == "--dir")
+            {
+                opt.dir = value;
+                if (!opt.dir.empty () && opt.dir.back () != '\\' && opt.dir.back () != '/')
+                    opt.dir += '/';
+            }
+            else
+            {
+                std::cerr << "Unknown option " << key << std::endl;
+                return false;
+            }
+        }
+        catch (std::exception const&)
+        {
+            std::cerr << "Invalid value of " << key << ": " << value << std::endl;
+            return false;
+        }
+    }
+    if (opt.format != "json" && opt.format != "csv")
+    {
+        std::cerr << "Unknown format " << opt.format << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char** argv)
+{
+    options_t opt;
+    if (!parse_options (argc, argv, opt))
+        return 2;
+    opt.self = argv[0];
+
+    sseimgui.ddsfile_texture = dummy_texture;
+
+    if (!opt.peak_load.empty ())
+        return peak_load (opt);
+
+    if (!opt.generate.empty ())
+    {
+        generate_book (opt);
+        return save_book (opt.generate) ? 0 : 1;
+    }
+
+    auto results = run_cases (opt);
+    if (opt.format == "csv")
+        print_csv (opt, results);
+    else
+        print_json (opt, results);
+
+    return std::all_of (results.cbegin (), results.cend (), [] (auto const& r) { return r.ok; })
+        ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,86 @@
+/**
+ * @file strutils.hpp
+ * @internal
+ *
+ * This file is part of General Utilities project (aka Utils).
+ *
+ *   Utils is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Utils is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Utils If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Utilities
+ *
+ * @details
+ * Small help functions which seems to be reused across the projects. This file is
+ * dedicated to ones not depending on any platform.
+ */
+
+#ifndef STRUTILS_HPP
+#define STRUTILS_HPP
+
+#include <cstdint>
+#include <string>
+#include <array>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Helper function to upload to API callers a managed range of bytes
+
+template<class In, typename Out>
+void
+copy_string (In const& src, std::size_t* n, Out* dst)
+{
+    if (!n)
+        return;
+    if (dst)
+    {
+        if (*n > 0)
+            *std::copy_n (src.cbegin (), std::min (*n-1, src.size ()), dst) = '\0';
+        else *dst = 0;
+    }
+    *n = src.size () + 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Converts any scalar to a 0xabcde string (made for fun)
+
+template<class T> static
+std::string hex_string (T v, bool shrink = true)
+{
+    std::array<char, sizeof (T)*2+2+1> dst;
+    auto x = shrink ? int (dst.size () - 2) : 2;
+    constexpr char lut[16] = {'0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'};
+    for (auto i = int (dst.size ()-1); i--; v >>= 4)
+    {
+        dst[i] = lut[v & 0xF];
+        if (shrink && (v & 0xf)) x = i;
+    }
+    dst.back () = '\0';
+    dst[x-1] = 'x';
+    dst[x-2] = '0';
+    return dst.data () + x - 2;
+}
+
+template<class T> static inline
+std::string hex_string (T* v)
+{
+    return hex_string (std::uintptr_t (v));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -29,6 +29,8 @@
 #ifndef WINUTILS_HPP
 #define WINUTILS_HPP
 
+#include <utils/strutils.hpp>
+
 #include <cstring>
 #include <string>
 #include <array>
@@ -83,52 +85,6 @@ utf16_to_utf8 (wchar_t const* wide, T& out)
 
 //--------------------------------------------------------------------------------------------------
 
-/// Helper function to upload to API callers a managed range of bytes
-
-template<class In, typename Out>
-void
-copy_string (In const& src, std::size_t* n, Out* dst)
-{
-    if (!n)
-        return;
-    if (dst)
-    {
-        if (*n > 0)
-            *std::copy_n (src.cbegin (), std::min (*n-1, src.size ()), dst) = '\0';
-        else *dst = 0;
-    }
-    *n = src.size () + 1;
-}
-
-//--------------------------------------------------------------------------------------------------
-
-/// Converts any scalar to a 0xabcde string (made for fun)
-
-template<class T> static
-std::string hex_string (T v, bool shrink = true)
-{
-    std::array<char, sizeof (T)*2+2+1> dst;
-    auto x = shrink ? int (dst.size () - 2) : 2;
-    constexpr char lut[16] = {'0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'};
-    for (auto i = int (dst.size ()-1); i--; v >>= 4)
-    {
-        dst[i] = lut[v & 0xF];
-        if (shrink && (v & 0xf)) x = i;
-    }
-    dst.back () = '\0';
-    dst[x-1] = 'x';
-    dst[x-2] = '0';
-    return dst.data () + x - 2;
-}
-
-template<class T> static inline
-std::string hex_string (T* v)
-{
-    return hex_string (std::uintptr_t (v));
-}
-
-//--------------------------------------------------------------------------------------------------
-
 template<class T>
 bool
 known_folder_path (REFKNOWNFOLDERID rfid, T& path)
@@ -0,0 +1,514 @@
+/**
+ * @file book.cpp
+ * @brief Bookkeeping of the in-memory book: edit notifications and snapshots
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Every change of the journal pages is either done here or reported here, so that the data
+ * derived from them stays in sync. For now that is what has changed since the last save, which
+ * makes the edit log (see fileio.cpp) possible, and the rows of the Chapters list, so it is not
+ * rebuilt each frame.
+ *
+ * Pages of a mapped binary book are loaded on demand: until a page is shown, only its title is
+ * in the page_t, while its content stays a view in the mapping, and its image is not loaded.
+ * Such pages go to snapshots straight from the mapping.
+ */
+
+#include "sse-journal.hpp"
+
+#include <sstream>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+struct page_cache_t
+{
+    /// Only for the pages not loaded yet, the content is then here only. The texts of the other
+    /// pages are shared by the snapshots with their page_t.
+    shared_text content;
+    /// Text not edited since the last save
+    bool saved = false;
+    /// The page_t holds the content and the image
+    bool loaded = true;
+    /// Image as of the last save, as its changes are not reported. No texture if not loaded.
+    image_t image = {};
+    /// Only for the pages not loaded yet
+    std::string image_file;
+    /// The title was checked for anything to show since last edited, and whether it is blank
+    bool title_checked = false;
+    bool title_blank = false;
+    /// Listed in #retitled already
+    bool retitled = false;
+};
+
+static std::vector<page_cache_t> page_cache;
+
+/// The mapped book, the pages not loaded yet come from
+static std::shared_ptr<const mapped_book> source_book;
+
+static unsigned generation = 0;
+
+/// Bumped by each change of the pages
+static unsigned revision = 0;
+
+/// The file the last save went to (or the book loaded from), empty if none
+static std::string saved_file;
+
+/// Size of the edit log of #saved_file
+static std::size_t edit_log_bytes = 0;
+
+/// Page insertions and removals since the last save, as edit log records
+static std::string structure_records;
+
+/// The Chapters list as last built, for the prefix it was built with
+static std::vector<chapter_t> chapters;
+static std::string chapters_prefix;
+static bool chapters_built = false;
+
+/// Pages edited since the list was built, only their titles need a new look. Kept only while
+/// the list is built, each page once.
+static std::vector<std::size_t> retitled;
+
+//--------------------------------------------------------------------------------------------------
+
+static bool
+same_image (image_t const& a, image_t const& b)
+{
+    return a.ref == b.ref && a.background == b.background && a.tint == b.tint
+        && a.uv == b.uv && a.xy == b.xy;
+}
+
+static shared_text
+own_text (std::string_view text)
+{
+    auto s = std::make_shared<const std::string> (text);
+    return shared_text { s, *s };
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The Chapters list is to be built again, or has been, so no page waits for a new look
+
+static void
+forget_retitled ()
+{
+    for (auto ndx: retitled)
+        if (ndx < page_cache.size ())
+            page_cache[ndx].retitled = false;
+    retitled.clear ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// One line in the edit log, written in the compact JSON form
+
+template<class F>
+static void
+edit_record (std::ostream& os, F&& fill)
+{
+    json_writer json (os, json_writer::style::compact);
+    json.begin_object ();
+    fill (json);
+    json.end_object ();
+    json.flush ();
+    os << '\n';
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+page_edited (std::size_t ndx)
+{
+    if (ndx < page_cache.size ())
+    {
+        auto& c = page_cache[ndx];
+        c.saved = false;
+        c.title_checked = false;
+        if (chapters_built && !c.retitled)
+        {
+            c.retitled = true;
+            retitled.push_back (ndx);
+        }
+    }
+    ++revision;
+    index_page_edited (ndx);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+insert_page (std::size_t ndx)
+{
+    forget_retitled ();
+    journal.pages.insert (journal.pages.begin () + ndx, page_t {});
+    if (ndx <= page_cache.size ())
+    {
+        page_cache_t c;
+        c.saved = true;
+        page_cache.insert (page_cache.begin () + ndx, std::move (c));
+    }
+    chapters_built = false;
+    ++revision;
+    index_page_inserted (ndx);
+
+    std::ostringstream os;
+    edit_record (os, [ndx] (json_writer& json) { json.key ("insert").value (ndx); });
+    structure_records += os.str ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+erase_page (std::size_t ndx)
+{
+    forget_retitled ();
+    journal.pages.erase (journal.pages.begin () + ndx);
+    if (ndx < page_cache.size ())
+        page_cache.erase (page_cache.begin () + ndx);
+    chapters_built = false;
+    ++revision;
+    index_page_erased (ndx);
+
+    std::ostringstream os;
+    edit_record (os, [ndx] (json_writer& json) { json.key ("erase").value (ndx); });
+    structure_records += os.str ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+book_replaced (std::shared_ptr<const mapped_book> book, std::vector<std::size_t> const& sources)
+{
+    page_cache.clear ();
+    page_cache.resize (journal.pages.size ());
+    for (std::size_t i = 0; i < page_cache.size (); ++i)
+    {
+        page_cache[i].saved = true;
+        page_cache[i].image = journal.pages[i].image;
+    }
+
+    source_book = std::move (book);
+    if (source_book)
+        for (std::size_t i = 0; i < sources.size () && i < page_cache.size (); ++i)
+        {
+            if (sources[i] == std::size_t (-1))
+                continue;
+            auto const& e = source_book->page (sources[i]);
+            auto& c = page_cache[i];
+            c.loaded = false;
+            c.content = shared_text { source_book, source_book->text (e.content) };
+            c.image.background = e.background;
+            c.image.tint = e.tint;
+            c.image.uv = e.uv;
+            c.image.xy = e.xy;
+            c.image_file = source_book->text (e.image_file);
+        }
+
+    saved_file.clear ();
+    edit_log_bytes = 0;
+    structure_records.clear ();
+    chapters_built = false;
+    retitled.clear ();
+    ++revision;
+    index_book_replaced ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+page_t&
+touch_page (std::size_t ndx)
+{
+    auto& p = journal.pages[ndx];
+    if (ndx < page_cache.size () && !page_cache[ndx].loaded)
+    {
+        auto& c = page_cache[ndx];
+        p.content = c.content.view;
+        // Taken from the page_t by the next snapshot, so this one does not keep the mapping
+        c.content = {};
+        p.image = c.image;
+        if (!c.image_file.empty ())
+            obtain_image (c.image_file, p.image);
+        c.image = p.image;
+        c.image_file.clear ();
+        c.loaded = true;
+    }
+    return p;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+prefetch_pages (std::size_t ndx)
+{
+    // One at a time, so flipping a page costs at most one extra image load per frame
+    for (auto i: { ndx + 2, ndx + 3, ndx - 2, ndx - 1 })
+        if (i < page_cache.size () && !page_cache[i].loaded)
+        {
+            touch_page (i);
+            return;
+        }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::string_view
+page_content (std::size_t ndx)
+{
+    if (ndx < page_cache.size () && !page_cache[ndx].loaded)
+        return page_cache[ndx].content.view;
+    return journal.pages[ndx].content.view ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+unsigned
+book_revision ()
+{
+    return revision;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static bool
+blank_title (std::size_t ndx)
+{
+    auto& c = page_cache[ndx];
+    if (!c.title_checked)
+    {
+        c.title_blank = !visible_symbols (journal.pages[ndx].title);
+        c.title_checked = true;
+    }
+    return c.title_blank;
+}
+
+static bool
+starts_folded (std::string_view text, std::string_view prefix)
+{
+    auto fold = [] (char c) { return c >= 'A' && c <= 'Z' ? char (c - 'A' + 'a') : c; };
+    return text.size () >= prefix.size ()
+        && std::equal (prefix.begin (), prefix.end (), text.begin (),
+                [&fold] (char a, char b) { return fold (a) == fold (b); });
+}
+
+std::vector<chapter_t> const&
+chapter_list (std::string_view prefix)
+{
+    // Or the pages were changed behind the notifications
+    if (page_cache.size () != journal.pages.size ())
+    {
+        page_cache.resize (journal.pages.size ());
+        chapters_built = false;
+    }
+
+    // An edit only changes the row of its page, unless filtering
+    if (chapters_built && prefix == chapters_prefix
+            && (prefix.empty () ? chapters.size () == journal.pages.size () : retitled.empty ()))
+    {
+        for (auto ndx: retitled)
+            if (ndx < chapters.size ())
+                chapters[ndx].blank = blank_title (ndx);
+        forget_retitled ();
+        return chapters;
+    }
+
+    chapters.clear ();
+    for (std::size_t i = 0; i < journal.pages.size (); ++i)
+        if (prefix.empty () || starts_folded (journal.pages[i].title, prefix))
+            chapters.push_back (chapter_t { i, blank_title (i) });
+    chapters_prefix = prefix;
+    chapters_built = true;
+    forget_retitled ();
+    return chapters;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+book_saved (std::string const& file, std::size_t log_size)
+{
+    if (page_cache.size () != journal.pages.size ())
+        page_cache.resize (journal.pages.size ());
+    for (std::size_t i = 0; i < page_cache.size (); ++i)
+    {
+        page_cache[i].saved = true;
+        if (page_cache[i].loaded)
+            page_cache[i].image = journal.pages[i].image;
+    }
+    saved_file = file;
+    edit_log_bytes = log_size;
+    structure_records.clear ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::string const&
+book_saved_file ()
+{
+    return saved_file;
+}
+
+std::size_t
+edit_log_size ()
+{
+    return edit_log_bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::string
+take_edit_records ()
+{
+    std::ostringstream os;
+    os << structure_records;
+    structure_records.clear ();
+
+    if (page_cache.size () != journal.pages.size ())
+        throw std::logic_error ("Edit log out of sync with the pages");
+
+    for (std::size_t i = 0; i < page_cache.size (); ++i)
+    {
+        auto const& p = journal.pages[i];
+        auto& c = page_cache[i];
+        if (!c.loaded || (c.saved && same_image (c.image, p.image)))
+            continue;
+
+        auto it = journal.images.find (p.image.ref);
+        edit_record (os, [&] (json_writer& json)
+        {
+            json.key ("page").value (i)
+                .key ("title").value (p.title.view ())
+                .key ("content").value (p.content.view ())
+                .key ("image").begin_object ()
+                    .key ("background").value (p.image.background)
+                    .key ("file").value (it == journal.images.end () ? "" : it->second.file)
+                    .key ("tint").value (hex_string (p.image.tint))
+                    .key ("uv").begin_array ();
+            for (float uv: p.image.uv) json.value (uv);
+            json.end_array ()
+                    .key ("xy").begin_array ();
+            for (float xy: p.image.xy) json.value (xy);
+            json.end_array ()
+                .end_object ();
+        });
+        c.saved = true;
+        c.image = p.image;
+    }
+
+    edit_record (os, [] (json_writer& json) { json.key ("current").value (journal.current_page); });
+
+    auto records = os.str ();
+    edit_log_bytes += records.size ();
+    return records;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const book_snapshot_t>
+snapshot_book (std::string const& destination)
+{
+    if (page_cache.size () != journal.pages.size ())
+        page_cache.resize (journal.pages.size ());
+
+    auto book = std::make_shared<book_snapshot_t> ();
+
+    // A mapped file can not be replaced, so the pages still in it are copied out and it is let go
+    if (source_book && source_book->path () == destination)
+    {
+        for (auto& c: page_cache)
+            if (c.content.owner == source_book)
+                c.content = own_text (c.content.view);
+        book->unmapped = source_book;
+        source_book.reset ();
+    }
+
+    book->generation = ++generation;
+    book->current = journal.current_page;
+    book->pages.reserve (journal.pages.size ());
+
+    for (std::size_t i = 0; i < journal.pages.size (); ++i)
+    {
+        auto const& p = journal.pages[i];
+        auto const& c = page_cache[i];
+        // Not copied, the page texts copy their buffers only when edited while shared
+        if (!c.loaded)
+        {
+            book->pages.push_back (page_snapshot_t {
+                    p.title.share (), c.content, c.image, c.image_file });
+            continue;
+        }
+        auto it = journal.images.find (p.image.ref);
+        book->pages.push_back (page_snapshot_t {
+                p.title.share (), p.content.share (), p.image,
+                it == journal.images.end () ? std::string () : it->second.file });
+    }
+
+    return book;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+release_image (image_t& img)
+{
+    auto it = journal.images.find (img.ref);
+    if (it == journal.images.end ())
+        return;
+    if (--it->second.refcount == 0)
+    {
+        release_texture (it->first);
+        journal.images.erase (it);
+    }
+    img.ref = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+obtain_image (std::string const& file, image_t& img)
+{
+    profile_scope scope ("obtain_image");
+    auto it = std::find_if (journal.images.begin (), journal.images.end (),
+            [&file] (auto const& kv) { return kv.second.file == file; });
+
+    if (it == journal.images.end ())
+    {
+        ID3D11ShaderResourceView* ref = nullptr;
+        if (!sseimgui.ddsfile_texture (file.c_str (), nullptr, &ref))
+            return false;
+        it = journal.images.emplace (ref, journal_t::image_source_t { 1, std::move (file) }).first;
+    }
+    else if (img.ref == it->first)
+    {
+        return true; // Happens if clicking buttons
+    }
+    else
+    {
+        release_image (img); //if any
+    }
+
+    img.ref = it->first;
+    ++it->second.refcount;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
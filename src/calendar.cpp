@@ -0,0 +1,219 @@
+/**
+ * @file calendar.cpp
+ * @brief Formatting of the in-game and of the local time
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The game memory is read in variables.cpp, here only the obtained values are formatted.
+ */
+
+#include "sse-journal.hpp"
+
+#include <array>
+#include <string>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+
+//--------------------------------------------------------------------------------------------------
+
+static std::string
+local_time (const char* format, std::tm& lt)
+{
+    std::string s;
+    std::size_t n = 16;
+    do
+    {
+        s.resize (n-1);
+        if (auto r = std::strftime (&s[0], n-1, format, &lt))
+        {
+            s.resize (r);
+            break;
+        }
+        n *= 2;
+    }
+    while (n < 512);
+    return s;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The % substitutions of the Game time variable, the order being that of the switch below
+static const std::initializer_list<std::string_view> game_time_names = {
+    "y", "Y", "lm", "bm", "am", "mo", "md", "sd", "ld", "wd", "h", "m", "s", "ri", "r" };
+
+void
+compile_game_time (format_program& program, std::string_view format)
+{
+    program.compile (format, game_time_names);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+append_number (std::string& out, int n)
+{
+    char buff[16];
+    out.append (buff, std::to_chars (buff, buff + sizeof (buff), n).ptr);
+}
+
+/// The days since the game start, hour, minute and second of @p epoch
+static std::array<int, 4>
+game_clock (float epoch)
+{
+    float hms = epoch - int (epoch);
+    int h = int (hms *= 24);
+    hms  -= int (hms);
+    int m = int (hms *= 60);
+    hms  -= int (hms);
+    int s = int (hms * 60);
+    return { int (epoch), h, m, s };
+}
+
+/**
+ * Very simple custom formatted time printing for the Skyrim calendar.
+ *
+ * Preparses some stuff before calling back strftime()
+ */
+
+void
+game_time (std::string& out, format_program const& program, float epoch)
+{
+    out.clear ();
+    if (!std::isnormal (epoch) || epoch < 0)
+    {
+        out = "(n/a)";
+        return;
+    }
+
+    // Compute the format input
+    auto [days, h, m, s] = game_clock (epoch);
+
+    // Adjusts for starting date: Sun, 17 Jul 201 (considering that the year starts Wed)
+    int d = days + 228;
+    int y = d / 365 + 201;
+    int yd = d % 365 + 1;
+    int wd = (d+3) % 7;
+
+    static constexpr std::array<int, 12> months = {
+        31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365 };
+    auto mit = std::lower_bound (months.cbegin (), months.cend (), yd);
+    int mo = mit - months.cbegin ();
+    int md = (mo ? yd-*(mit-1) : yd);
+
+    static constexpr std::array<const char*, 12> longmon = {
+        "Morning Star", "Sun's Dawn", "First Seed", "Rain's Hand", "Second Seed", "Midyear",
+        "Sun's Height", "Last Seed", "Hearthfire", "Frostfall", "Sun's Dusk", "Evening Star"
+    };
+    static constexpr std::array<const char*, 12> birtmon = {
+        "The Ritual", "The Lover", "The Lord", "The Mage", "The Shadow", "The Steed",
+        "The Apprentice", "The Warrior", "The Lady", "The Tower", "The Atronach", "The Thief"
+    };
+    static constexpr std::array<const char*, 12> argomon = {
+        "Vakka (Sun)", "Xeech (Nut)", "Sisei (Sprout)", "Hist-Deek (Hist Sapling)",
+        "Hist-Dooka (Mature Hist)", "Hist-Tsoko (Elder Hist)", "Thtithil-Gah (Egg-Basket)",
+        "Thtithil (Egg)", "Nushmeeko (Lizard)", "Shaja-Nushmeeko (Semi-Humanoid Lizard)",
+        "Saxhleel (Argonian)", "Xulomaht (The Deceased)"
+    };
+    static constexpr std::array<const char*, 7> longwday = {
+        "Sundas", "Morndas", "Tirdas", "Middas", "Turdas", "Fredas", "Loredas"
+    };
+    static constexpr std::array<const char*, 7> shrtwday = {
+        "Sun", "Mor", "Tir", "Mid", "Tur", "Fre", "Lor"
+    };
+
+    program.run (out, [&] (int substitution, std::string&) {
+        switch (substitution)
+        {
+            // Years
+            case 0: append_number (out, y); break;
+            case 1: out += "4E"; append_number (out, y); break;
+            // Months
+            case 2: out += longmon[mo]; break;
+            case 3: out += birtmon[mo]; break;
+            case 4: out += argomon[mo]; break;
+            case 5: append_number (out, mo+1); break;
+            case 6: append_number (out, md); break;
+            // Weekdays
+            case 7: out += shrtwday[wd]; break;
+            case 8: out += longwday[wd]; break;
+            case 9: append_number (out, wd+1); break;
+            // Time
+            case 10: append_number (out, h); break;
+            case 11: append_number (out, m); break;
+            case 12: append_number (out, s); break;
+            // Raw, as std::to_string () gives it
+            case 13: append_number (out, d); break;
+            case 14:
+            {
+                char buff[64];
+                out.append (buff, std::snprintf (buff, sizeof (buff), "%f", epoch));
+                break;
+            }
+        }
+    });
+}
+
+std::string
+game_time (std::string_view format, float epoch)
+{
+    format_program program;
+    compile_game_time (program, format);
+    std::string out;
+    game_time (out, program, epoch);
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+game_time_inputs (std::string& key, format_program const& program, float epoch)
+{
+    if (!std::isnormal (epoch) || epoch < 0)
+    {
+        key += '-';
+        return;
+    }
+    // The seconds and the raw value change a few times per real second, the rest per game minute
+    if (program.uses (12) || program.uses (14))
+    {
+        key.append (reinterpret_cast<const char*> (&epoch), sizeof (epoch));
+        return;
+    }
+    auto clock = game_clock (epoch);
+    key.append (reinterpret_cast<const char*> (clock.data ()), 3 * sizeof (int));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::string
+local_time (const char* format)
+{
+    std::time_t t = std::time (nullptr);
+    std::tm* lt = std::localtime (&t);
+    return local_time (format, *lt);
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,276 @@
+/**
+ * @file commands.cpp
+ * @brief Commands sent by other mods, queued from their threads and run on the render one
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The SKSE message type tells the command, its data is UTF-8 text (up to a zero, if any). Any mod
+ * sends it as command_message_base (0x4A524E00) plus the number below, the mods already sending
+ * commands before (see #command_senders) may send just the number:
+ *
+ * - 1 (find): "text" or "text@book", shows the first page having the text, in the given book
+ *   of the books directory (without the .json extension) if any. As SSE-MapTrack sends it.
+ * - 2 (goto): "page" or "page@book", shows the page, counted from zero.
+ * - 3 (append): "page\ntext", appends the text to the content of the page, or of the last page
+ *   if the page is empty.
+ * - 4 (entry): "title\ntext", adds a page with these at the end and shows it.
+ *
+ * Nothing waits: a full queue drops the command, which is reported once drained.
+ */
+
+#include "sse-journal.hpp"
+
+#include <charconv>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Commands waiting for the render thread
+constexpr std::size_t queue_size = 256;
+
+struct command_t
+{
+    command_kind kind;
+    std::size_t page;       ///< Of goto and append, npos for the last one
+    std::string text;       ///< What to find or append, the content of a new entry
+    std::string extra;      ///< Book to load first, or the title of a new entry
+};
+
+struct command_queue_t
+{
+    mpsc_queue<command_t, queue_size> commands;
+    std::atomic<std::size_t> dropped;
+};
+
+/// Never destroyed, as the SKSE messaging may still post at exit
+static command_queue_t& queue = *new command_queue_t {};
+
+/// Sending the bare command kinds, as they did before the reserved message types
+const std::array<const char*, 1> command_senders = { "sse-maptrack" };
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+message_command (std::string_view sender, std::uint32_t type, command_kind& kind)
+{
+    constexpr auto first = std::uint32_t (command_kind::find);
+    constexpr auto last = std::uint32_t (command_kind::new_entry);
+    if (type - command_message_base - first <= last - first)
+        type -= command_message_base;
+    else if (type - first > last - first
+            || std::find (command_senders.begin (), command_senders.end (), sender)
+                == command_senders.end ())
+        return false;
+    kind = command_kind (type);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Splits @p s at the first @p c, the second part being empty if none
+
+static std::pair<std::string_view, std::string_view>
+split_first (std::string_view s, char c)
+{
+    auto pos = s.find (c);
+    if (pos == std::string_view::npos)
+        return { s, {} };
+    return { s.substr (0, pos), s.substr (pos + 1) };
+}
+
+static std::pair<std::string_view, std::string_view>
+split_last (std::string_view s, char c)
+{
+    auto pos = s.rfind (c);
+    if (pos == std::string_view::npos)
+        return { s, {} };
+    return { s.substr (0, pos), s.substr (pos + 1) };
+}
+
+static bool
+parse_page (std::string_view s, std::size_t& page)
+{
+    auto end = s.data () + s.size ();
+    auto [ptr, ec] = std::from_chars (s.data (), end, page);
+    return ec == std::errc () && ptr == end;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+post_command (command_kind kind, std::string_view data)
+{
+    data = data.substr (0, data.find ('\0'));
+
+    command_t c { kind, std::string_view::npos, {}, {} };
+    bool ok = true;
+    switch (kind)
+    {
+        case command_kind::find:
+        {
+            auto [text, book] = split_last (data, '@');
+            c.text = text;
+            c.extra = book;
+            ok = !text.empty ();
+            break;
+        }
+        case command_kind::goto_page:
+        {
+            auto [page, book] = split_last (data, '@');
+            c.extra = book;
+            ok = parse_page (page, c.page);
+            break;
+        }
+        case command_kind::append:
+        {
+            auto [page, text] = split_first (data, '\n');
+            c.text = text;
+            ok = page.empty () || parse_page (page, c.page);
+            break;
+        }
+        case command_kind::new_entry:
+        {
+            auto [title, text] = split_first (data, '\n');
+            c.extra = title;
+            c.text = text;
+            break;
+        }
+        default:
+            ok = false;
+    }
+
+    if (!ok)
+    {
+        log (log_level::warning) << "Ignoring malformed mod command " << int (kind) << ": "
+                                 << data << std::endl;
+        return false;
+    }
+    if (!queue.commands.push (c))
+    {
+        queue.dropped.fetch_add (1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Loads the book named by a command, if it names any
+
+static bool
+load_command_book (std::string const& name)
+{
+    if (name.empty ())
+        return true;
+    auto book = books_directory + name + ".json";
+    if (load_book (book))
+        return true;
+    log (log_level::error) << "Unable to load mod requested book " << book << std::endl;
+    return false;
+}
+
+/// The journal shows two pages from the current one
+
+static void
+show_page (std::size_t page)
+{
+    journal.current_page = std::min (page, journal.pages.size () - 2);
+}
+
+static bool
+run_command (command_t const& c)
+{
+    switch (c.kind)
+    {
+        case command_kind::find:
+        {
+            if (!load_command_book (c.extra))
+                return false;
+            auto page = find_page (c.text);
+            if (page == journal.pages.size ())
+            {
+                log (log_level::error) << "Unable to find mod requested string " << c.text
+                                       << std::endl;
+                return false;
+            }
+            show_page (page);
+            return true;
+        }
+        case command_kind::goto_page:
+        {
+            if (!load_command_book (c.extra))
+                return false;
+            if (c.page >= journal.pages.size ())
+            {
+                log (log_level::error) << "Unable to go to mod requested page " << c.page
+                                       << std::endl;
+                return false;
+            }
+            show_page (c.page);
+            return true;
+        }
+        case command_kind::append:
+        {
+            auto page = c.page == std::string_view::npos ? journal.pages.size () - 1 : c.page;
+            if (page >= journal.pages.size ())
+            {
+                log (log_level::error) << "Unable to append to mod requested page " << c.page
+                                       << std::endl;
+                return false;
+            }
+            touch_page (page).content += c.text;
+            page_edited (page);
+            return false;
+        }
+        case command_kind::new_entry:
+        {
+            auto page = journal.pages.size ();
+            insert_page (page);
+            auto& p = touch_page (page);
+            p.title = c.extra;
+            p.content = c.text;
+            page_edited (page);
+            show_page (page);
+            return true;
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+run_commands (std::size_t budget)
+{
+    if (auto n = queue.dropped.exchange (0, std::memory_order_relaxed))
+        log (log_level::warning) << n << " mod commands dropped, too many at once." << std::endl;
+
+    // Reused, so the strings keep their room between the frames
+    static command_t c { command_kind::find, 0, {}, {} };
+    bool show = false;
+    for (; budget && queue.commands.pop (c); --budget)
+        show = run_command (c) || show;
+    return show;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -33,6 +33,12 @@
 #include <fstream>
 #include <vector>
 #include <iterator>
+#include <algorithm>
+#include <cstdio>
+#include <charconv>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 // Warning come in a BSON parser, which is not used, and probably shouldn't be
 #if defined(__GNUC__)
@@ -51,12 +57,98 @@ std::string default_book      = books_directory   + "default_book.json";
 std::string settings_location = journal_directory + "settings.json";
 std::string variables_location= journal_directory + "variables.json";
 std::string images_directory  = journal_directory + "images\\";
+std::string library_location  = journal_directory + "library.msgpack";
+
+//--------------------------------------------------------------------------------------------------
+
+/// Books and settings are JSON, or one of the binary encodings nlohmann provides, by extension
+
+enum class encoding { json, cbor, msgpack };
+
+static encoding
+encoding_of (std::string const& file)
+{
+    if (file.ends_with (".cbor")) return encoding::cbor;
+    if (file.ends_with (".msgpack")) return encoding::msgpack;
+    return encoding::json;
+}
+
+static nlohmann::json::input_format_t
+input_format (encoding e)
+{
+    if (e == encoding::cbor) return nlohmann::json::input_format_t::cbor;
+    if (e == encoding::msgpack) return nlohmann::json::input_format_t::msgpack;
+    return nlohmann::json::input_format_t::json;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Same interface as the #json_writer, but builds a document for the nlohmann binary writers.
+ *
+ * This way the one function describing a file serves all the encodings.
+ */
+
+class json_builder
+{
+public:
+    nlohmann::json root;
+
+    json_builder& begin_object () { return open (nlohmann::json::object ()); }
+    json_builder& begin_array () { return open (nlohmann::json::array ()); }
+    json_builder& end_object () { stack.pop_back (); return *this; }
+    json_builder& end_array () { stack.pop_back (); return *this; }
+    json_builder& key (std::string_view k) { pending_key = k; return *this; }
+
+    template<class T>
+    json_builder& value (T const& v)
+    {
+        place (nlohmann::json (v));
+        return *this;
+    }
+    json_builder& value (std::string_view v) { return value (std::string (v)); }
+
+    void flush () {}
+
+    /// Throws on failure
+    void write (std::ostream& os, encoding e) const
+    {
+        if (e == encoding::cbor) nlohmann::json::to_cbor (root, os);
+        else if (e == encoding::msgpack) nlohmann::json::to_msgpack (root, os);
+        else os << root.dump (4);
+    }
+
+private:
+    // Children do not move while open, as only the innermost container grows
+    std::vector<nlohmann::json*> stack;
+    std::string pending_key;
+
+    nlohmann::json& place (nlohmann::json&& j)
+    {
+        if (stack.empty ())
+            return root = std::move (j);
+        auto& top = *stack.back ();
+        if (top.is_array ())
+        {
+            top.push_back (std::move (j));
+            return top.back ();
+        }
+        return top[pending_key] = std::move (j);
+    }
+
+    json_builder& open (nlohmann::json&& j)
+    {
+        stack.push_back (&place (std::move (j)));
+        return *this;
+    }
+};
 
 //--------------------------------------------------------------------------------------------------
 
 bool
 save_text (std::string const& destination)
 {
+    profile_scope scope ("save_text");
     int maj, min, patch;
     const char* timestamp;
     journal_version (&maj, &min, &patch, &timestamp);
@@ -66,7 +158,8 @@ save_text (std::string const& destination)
         std::ofstream of (destination);
         if (!of.is_open ())
         {
-            log () << "Unable to open " << destination << " for writting." << std::endl;
+            log (log_level::error) << "Unable to open " << destination << " for writting."
+                                   << std::endl;
             return false;
         }
 
@@ -74,18 +167,17 @@ save_text (std::string const& destination)
            << journal.pages.size () << " pages exported on " << local_time ("%c") << '\n'
            << std::endl;
 
-        int i = 0;
-        for (auto const& p: journal.pages)
+        for (std::size_t i = 0; i < journal.pages.size (); ++i)
         {
-            of << "Page #" << std::to_string (i++) << '\n'
-               << p.title.c_str () << '\n'
-               << p.content.c_str () << '\n'
+            of << "Page #" << std::to_string (i) << '\n'
+               << journal.pages[i].title.view () << '\n'
+               << page_content (i) << '\n'
                << std::endl;
         }
     }
     catch (std::exception const& ex)
     {
-        log () << "Unable to save book: " << ex.what () << std::endl;
+        log (log_level::error) << "Unable to save book: " << ex.what () << std::endl;
         return false;
     }
     return true;
@@ -93,56 +185,214 @@ save_text (std::string const& destination)
 
 //--------------------------------------------------------------------------------------------------
 
-bool
-save_book (std::string const& destination)
+/// Calls @p f for each number in [0, n) in the order nlohmann keeps them as object keys
+
+template<class F>
+static void
+for_each_in_key_order (std::size_t n, F&& f)
+{
+    if (!n)
+        return;
+    f (std::size_t (0));
+    std::size_t k = 1;
+    for (std::size_t i = 1; i < n; ++i)
+    {
+        f (k);
+        if (k * 10 < n)
+            k *= 10;
+        else
+        {
+            while (k % 10 == 9 || k + 1 >= n)
+                k /= 10;
+            ++k;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+template<class Writer>
+static void
+write_version (Writer& json)
 {
     int maj, min, patch;
     const char* timestamp;
     journal_version (&maj, &min, &patch, &timestamp);
 
+    json.key ("version").begin_object ()
+        .key ("major").value (maj)
+        .key ("minor").value (min)
+        .key ("patch").value (patch)
+        .key ("timestamp").value (timestamp)
+        .end_object ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Above that many bytes in the edit log, the next save rewrites the whole book instead
+constexpr std::size_t edit_log_limit = 1 << 20;
+
+std::string
+edit_log_file (std::string const& book)
+{
+    return book + ".log";
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Replaces the destination with the fully written temporary file, no half-written books
+
+static void
+commit_file (std::string const& temporary, std::string const& destination)
+{
     try
     {
-        nlohmann::json json = {
-            { "version", {
-                { "major", maj },
-                { "minor", min },
-                { "patch", patch },
-                { "timestamp", timestamp }
-            }},
-            { "size", journal.pages.size () },
-            { "current", journal.current_page },
-            { "pages", nlohmann::json::object () }
-        };
-
-        int i = 0;
-        for (auto const& p: journal.pages)
-        {
-            auto it = journal.images.find (p.image.ref);
-            json["pages"][std::to_string (i++)] = {
-                { "title", p.title.c_str () },
-                { "content", p.content.c_str () },
-                { "image",  {
-                    { "file", it == journal.images.end () ? "" : it->second.file.c_str () },
-                    { "background", p.image.background },
-                    { "tint", hex_string (p.image.tint) },
-                    { "uv", { p.image.uv[0], p.image.uv[1], p.image.uv[2], p.image.uv[3] }},
-                    { "xy", { p.image.xy[0], p.image.xy[1], p.image.xy[2], p.image.xy[3] }}
-                }}
-            };
-        }
+        replace_file (temporary, destination);
+    }
+    catch (...)
+    {
+        std::remove (temporary.c_str ());
+        throw;
+    }
+}
 
-        std::ofstream of (destination);
+//--------------------------------------------------------------------------------------------------
+
+/// Keys are in the same (sorted) order as the older, nlohmann generated, books
+
+template<class Writer>
+static void
+write_book_keys (book_snapshot_t const& book, Writer& json)
+{
+    json.begin_object ()
+        .key ("current").value (book.current)
+        .key ("pages").begin_object ();
+
+    for_each_in_key_order (book.pages.size (), [&json, &book] (std::size_t i)
+    {
+        auto const& p = book.pages[i];
+        json.key (std::to_string (i)).begin_object ()
+            .key ("content").value (p.content.view)
+            .key ("image").begin_object ()
+                .key ("background").value (p.image.background)
+                .key ("file").value (p.image_file)
+                .key ("tint").value (hex_string (p.image.tint))
+                .key ("uv").begin_array ();
+        for (float uv: p.image.uv) json.value (uv);
+        json.end_array ()
+                .key ("xy").begin_array ();
+        for (float xy: p.image.xy) json.value (xy);
+        json.end_array ()
+            .end_object ()
+            .key ("title").value (p.title.view)
+            .end_object ();
+    });
+
+    json.end_object ()
+        .key ("size").value (book.pages.size ());
+    write_version (json);
+    json.end_object ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Encoding (JSON in the given style) by the destination extension. Throws on failure, can be
+/// called from any thread
+
+static void
+write_book (book_snapshot_t const& book, std::string const& destination, json_writer::style style)
+{
+    profile_scope scope ("write_book");
+    auto temporary = destination + "." + std::to_string (book.generation) + ".tmp";
+    if (is_jbook (destination))
+    {
+        std::ofstream of (temporary, std::ios::binary);
         if (!of.is_open ())
-        {
-            log () << "Unable to open " << destination << " for writting." << std::endl;
-            return false;
-        }
+            throw std::runtime_error ("Unable to open " + temporary + " for writting.");
+        write_jbook (book, of);
+        of.close ();
+        if (!of)
+            throw std::runtime_error ("Unable to write " + temporary);
+    }
+    else if (auto e = encoding_of (destination); e != encoding::json)
+    {
+        json_builder json;
+        write_book_keys (book, json);
+        std::ofstream of (temporary, std::ios::binary);
+        if (!of.is_open ())
+            throw std::runtime_error ("Unable to open " + temporary + " for writting.");
+        json.write (of, e);
+        of.close ();
+        if (!of)
+            throw std::runtime_error ("Unable to write " + temporary);
+    }
+    else
+    {
+        std::ofstream of (temporary);
+        if (!of.is_open ())
+            throw std::runtime_error ("Unable to open " + temporary + " for writting.");
+
+        json_writer json (of, style);
+        write_book_keys (book, json);
+        json.flush ();
+        of.close ();
+        if (!of)
+            throw std::runtime_error ("Unable to write " + temporary);
+    }
+    // The search worker, cancelled by the snapshot taker, lets go of the mapping at its next page
+    if (!wait_unmapped (destination, 1000))
+    {
+        std::remove (temporary.c_str ());
+        throw std::runtime_error (destination + " is still mapped by an older snapshot.");
+    }
+    commit_file (temporary, destination);
 
-        of << json.dump (4);
+    file_info_t info { {}, 0, 0 };
+    if (tracing_enabled () && file_info (destination, info))
+    {
+        scope.arg ("pages", book.pages.size ());
+        scope.arg ("bytes", info.size);
+    }
+
+    // The book has everything now, a stale edit log would redo changes on it
+    remove_file (edit_log_file (destination));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Throws on failure, can be called from any thread
+
+static void
+append_edit_log (std::string const& destination, std::string const& records)
+{
+    auto log_file = edit_log_file (destination);
+    std::ofstream of (log_file, std::ios::binary | std::ios::app);
+    if (!of.is_open ())
+        throw std::runtime_error ("Unable to open " + log_file + " for writting.");
+    of.write (records.data (), records.size ());
+    of.close ();
+    if (!of)
+        throw std::runtime_error ("Unable to write " + log_file);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+save_book (std::string const& destination, json_writer::style style)
+{
+    profile_scope scope ("save_book");
+    try
+    {
+        auto book = snapshot_book (destination);
+        if (!book->unmapped.expired ())
+            release_book_snapshots ();
+        write_book (*book, destination, style);
+        book_saved (journal.edit_log ? destination : std::string ());
+        scope.arg ("pages", journal.pages.size ());
     }
     catch (std::exception const& ex)
     {
-        log () << "Unable to save book: " << ex.what () << std::endl;
+        log (log_level::error) << "Unable to save book: " << ex.what () << std::endl;
         return false;
     }
     return true;
@@ -150,75 +400,513 @@ save_book (std::string const& destination)
 
 //--------------------------------------------------------------------------------------------------
 
-bool
-load_book (std::string const& source)
+/// Background book saving: at most one save in flight, and one waiting - the newest request.
+/// With the edit log on, requests bring only their records, which must all reach the log.
+
+struct saver_t
 {
-    int maj;
-    journal_version (&maj, nullptr, nullptr, nullptr);
+    std::mutex lock;
+    std::condition_variable wake;
+    bool started;
+    std::shared_ptr<const book_snapshot_t> pending;  ///< Full book to write, if any
+    std::string records;                             ///< Edit log records to append after it
+    std::string destination;
+    unsigned requested, finished;   ///< Request tickets
+    std::string error;              ///< To be logged from the render thread
+};
+
+/// Never destroyed, as the detached worker may still wait on it at exit
+static saver_t& saver = *new saver_t {};
 
-    try
+static void
+saver_loop ()
+{
+    std::unique_lock<std::mutex> lock (saver.lock);
+    for (;;)
     {
-        std::ifstream fi (source);
-        if (!fi.is_open ())
+        saver.wake.wait (lock, [] { return saver.requested != saver.finished; });
+        auto book = std::move (saver.pending);
+        auto records = std::move (saver.records);
+        auto destination = saver.destination;
+        auto ticket = saver.requested;
+        saver.records.clear ();
+        lock.unlock ();
+
+        std::string error;
+        try
         {
-            log () << "Unable to open " << source << " for reading." << std::endl;
-            return false;
+            profile_scope scope ("save_book_async");
+            scope.arg ("log bytes", records.size ());
+            if (book)
+                write_book (*book, destination, json_writer::style::pretty);
+            if (!records.empty ())
+                append_edit_log (destination, records);
+        }
+        catch (std::exception const& ex)
+        {
+            error = ex.what ();
         }
 
-        nlohmann::json json;
-        fi >> json;
+        lock.lock ();
+        saver.finished = ticket;
+        if (!error.empty ())
+            saver.error = std::move (error);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
 
-        if (json["version"]["major"].get<int> () != maj)
+void
+save_book_async (std::string const& destination)
+{
+    // Either the changes go to the log of the same book, or it gets compacted into a new one
+    std::shared_ptr<const book_snapshot_t> book;
+    std::string records;
+    if (journal.edit_log && book_saved_file () == destination && edit_log_size () < edit_log_limit)
+        records = take_edit_records ();
+    else
+    {
+        book = snapshot_book (destination);
+        if (!book->unmapped.expired ())
+            release_book_snapshots ();
+        book_saved (journal.edit_log ? destination : std::string ());
+    }
+
+    std::lock_guard<std::mutex> lock (saver.lock);
+    if (!saver.started)
+    {
+        // Detached, as there is no orderly DLL shutdown to join it
+        std::thread (saver_loop).detach ();
+        saver.started = true;
+    }
+    if (book)
+    {
+        // A full book makes obsolete anything still waiting
+        saver.pending = std::move (book);
+        saver.records.clear ();
+    }
+    else if (saver.destination != destination)
+        saver.records.clear ();
+    saver.records += records;
+    saver.destination = destination;
+    ++saver.requested;
+    saver.wake.notify_one ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+save_status
+book_save_status ()
+{
+    std::lock_guard<std::mutex> lock (saver.lock);
+    if (!saver.error.empty ())
+    {
+        log (log_level::error) << "Unable to save book: " << saver.error << std::endl;
+        saver.error.clear ();
+        // Whatever made it to the disk, the next save starts anew
+        book_saved ("");
+        return save_status::failed;
+    }
+    return saver.requested != saver.finished ? save_status::saving : save_status::idle;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Streams a book straight into pages, as the strings are lexed, without intermediate DOM.
+ *
+ * The page keys may come in any order and with gaps, so each page is kept together with its
+ * number and sorted at the end. Everything not recognized is skipped, so the older or newer books
+ * can still be opened. The image textures are not requested here, as the book version is known
+ * only after the whole document is read (nlohmann sorts the keys, "version" comes last).
+ */
+
+class book_reader : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+    struct entry_t
+    {
+        unsigned long long ndx;
+        page_t page;
+        bool has_image;
+        std::string image_file;
+    };
+
+    int major = -1;
+    unsigned current = 0;
+    std::vector<entry_t> entries;
+
+private:
+    enum class node { root, version, pages, page, image, uv, xy, skip };
+
+    std::vector<node> stack;
+    std::string last_key;
+    unsigned element = 0; ///< Position inside the uv/xy arrays
+
+    node top () const { return stack.empty () ? node::skip : stack.back (); }
+
+    bool number (double v)
+    {
+        if (top () != node::uv && top () != node::xy)
+            return true;
+        auto& img = entries.back ().page.image;
+        auto& coords = top () == node::uv ? img.uv : img.xy;
+        if (element < coords.size ())
+            coords[element++] = float (v);
+        return true;
+    }
+
+    template<class T>
+    bool integer (T v)
+    {
+        if (top () == node::root && last_key == "current")
+            current = unsigned (v);
+        else if (top () == node::version && last_key == "major")
+            major = int (v);
+        else
+            number (double (v));
+        return true;
+    }
+
+public:
+    bool null () override { return true; }
+    bool binary (binary_t&) override { return true; }
+    bool number_integer (number_integer_t v) override { return integer (v); }
+    bool number_unsigned (number_unsigned_t v) override { return integer (v); }
+    bool number_float (number_float_t v, string_t const&) override { return number (v); }
+
+    bool boolean (bool v) override
+    {
+        if (top () == node::image && last_key == "background")
+            entries.back ().page.image.background = v;
+        return true;
+    }
+
+    bool string (string_t& v) override
+    {
+        if (top () == node::page)
         {
-            log () << "Incompatible book version." << std::endl;
+            auto& p = entries.back ().page;
+            if (last_key == "title")
+                p.title = std::move (v);
+            else if (last_key == "content")
+                p.content = std::move (v);
+        }
+        else if (top () == node::image)
+        {
+            auto& e = entries.back ();
+            if (last_key == "file")
+                e.image_file = std::move (v);
+            else if (last_key == "tint")
+                e.page.image.tint = std::stoull (v, nullptr, 0);
+        }
+        return true;
+    }
+
+    bool key (string_t& v) override
+    {
+        last_key = std::move (v);
+        return true;
+    }
+
+    bool start_object (std::size_t) override
+    {
+        auto next = node::skip;
+        if (stack.empty ())
+            next = node::root;
+        else if (top () == node::root && last_key == "version")
+            next = node::version;
+        else if (top () == node::root && last_key == "pages")
+            next = node::pages;
+        else if (top () == node::pages)
+        {
+            next = node::page;
+            entries.push_back (entry_t { std::stoull (last_key), page_t {}, false, "" });
+        }
+        else if (top () == node::page && last_key == "image")
+        {
+            next = node::image;
+            entries.back ().has_image = true;
+        }
+        stack.push_back (next);
+        return true;
+    }
+
+    bool end_object () override
+    {
+        stack.pop_back ();
+        return true;
+    }
+
+    bool start_array (std::size_t) override
+    {
+        auto next = node::skip;
+        if (top () == node::image && last_key == "uv")
+            next = node::uv;
+        else if (top () == node::image && last_key == "xy")
+            next = node::xy;
+        element = 0;
+        stack.push_back (next);
+        return true;
+    }
+
+    bool end_array () override
+    {
+        stack.pop_back ();
+        return true;
+    }
+
+    bool parse_error (std::size_t, std::string const&, nlohmann::detail::exception const& ex) override
+    {
+        throw std::runtime_error (ex.what ());
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// A book as read, before it replaces the journal one
+
+struct read_book_t
+{
+    std::vector<page_t> pages;
+    unsigned current;
+    /// Binary books are kept mapped, for their pages to be loaded later
+    std::shared_ptr<const mapped_book> mapped;
+    /// For each page: the one in #mapped to be loaded from, or -1 if loaded already
+    std::vector<std::size_t> sources;
+
+    void insert (std::size_t ndx)
+    {
+        pages.insert (pages.begin () + ndx, page_t {});
+        sources.insert (sources.begin () + ndx, std::size_t (-1));
+    }
+    void erase (std::size_t ndx)
+    {
+        pages.erase (pages.begin () + ndx);
+        sources.erase (sources.begin () + ndx);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Redoes the changes from the edit log of a book over its loaded pages.
+ *
+ * A torn or otherwise unusable record (e.g. the game crashed while writing it) ends the replay,
+ * as the records after it were done over a state which is not known.
+ *
+ * @param bytes receives the size of the replayed records
+ * @param messages where the problems are reported
+ * @param images whether to obtain the textures of the replayed pages
+ * @returns false if the replay stopped short of the end of the log
+ */
+
+static bool
+replay_edit_log (std::string const& source, read_book_t& book, std::size_t& bytes,
+        std::ostream& messages, bool images)
+{
+    bytes = 0;
+    std::ifstream fi (edit_log_file (source), std::ios::binary);
+    if (!fi.is_open ())
+        return true;
+
+    std::size_t records = 0;
+    for (std::string line; std::getline (fi, line); ++records)
+    {
+        if (fi.eof ())
+        {
+            messages << "Edit log record #" << records << " is incomplete." << std::endl;
             return false;
         }
 
-        auto current = json["current"].get<unsigned> ();
+        auto r = nlohmann::json::parse (line, nullptr, false);
+        if (r.is_discarded () || !r.is_object ())
+        {
+            messages << "Edit log record #" << records << " is unreadable." << std::endl;
+            return false;
+        }
 
-        std::map<int, page_t> pages; // a map for page sorting and gaps fixing
-        for (auto const& kv: json["pages"].items ())
+        try
         {
-            page_t p = {};
-            int ndx = std::stoull (kv.key ());
-            auto& v = kv.value ();
-            p.title = v["title"].get<std::string> ();
-            p.content = v["content"].get<std::string> ();
-            if (v.contains ("image"))
+            if (r.contains ("insert"))
             {
-                auto& vi = v["image"];
-                auto it = vi["uv"].begin ();
-                for (float& uv: p.image.uv) uv = *it++;
-                it = vi["xy"].begin ();
-                for (float& xy: p.image.xy) xy = *it++;
-                p.image.tint = std::stoull (vi["tint"].get<std::string> (), nullptr, 0);
-                p.image.background = vi["background"];
-                obtain_image (vi["file"], p.image); // resets p.image on success
+                std::size_t ndx = r["insert"];
+                if (ndx > book.pages.size ())
+                    throw std::out_of_range ("insert");
+                book.insert (ndx);
             }
-            pages.emplace (ndx, std::move (p));
+            else if (r.contains ("erase"))
+            {
+                std::size_t ndx = r["erase"];
+                if (ndx >= book.pages.size ())
+                    throw std::out_of_range ("erase");
+                book.erase (ndx);
+            }
+            else if (r.contains ("page"))
+            {
+                std::size_t ndx = r["page"];
+                if (ndx >= book.pages.size ())
+                    throw std::out_of_range ("page");
+                book.sources[ndx] = std::size_t (-1);
+                auto& p = book.pages[ndx];
+                p.title = r["title"].get<std::string> ();
+                p.content = r["content"].get<std::string> ();
+                auto const& ji = r["image"];
+                p.image = image_t {};
+                p.image.background = ji["background"];
+                p.image.tint = std::stoull (ji["tint"].get<std::string> (), nullptr, 0);
+                for (std::size_t i = 0; i < 4; ++i)
+                {
+                    p.image.uv[i] = ji["uv"][i];
+                    p.image.xy[i] = ji["xy"][i];
+                }
+                std::string file = ji["file"];
+                if (images && !file.empty ())
+                    obtain_image (file, p.image);
+            }
+            else if (r.contains ("current"))
+                book.current = r["current"];
+            else
+                throw std::invalid_argument ("unknown");
         }
+        catch (std::exception const& ex)
+        {
+            messages << "Edit log record #" << records << " does not apply: " << ex.what ()
+                   << std::endl;
+            return false;
+        }
+        bytes += line.size () + 1;
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Only the titles of binary books are read, the rest is loaded when the page is shown
+
+static bool
+read_jbook (std::string const& source, read_book_t& book)
+{
+    int maj;
+    journal_version (&maj, nullptr, nullptr, nullptr);
+
+    auto mapped = std::make_shared<const mapped_book> (source);
+    if (int (mapped->header ().major) != maj)
+    {
+        log (log_level::warning) << "Incompatible book version." << std::endl;
+        return false;
+    }
+
+    book.pages.resize (mapped->size ());
+    book.sources.resize (mapped->size ());
+    for (std::size_t i = 0; i < book.pages.size (); ++i)
+    {
+        book.pages[i].title = mapped->text (mapped->page (i).title);
+        book.sources[i] = i;
+    }
+    book.current = mapped->header ().current;
+    book.mapped = std::move (mapped);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Sorts the pages and fixes the gaps, same numbered ones are replaced by the latter
+
+static void
+sort_entries (std::vector<book_reader::entry_t>& entries)
+{
+    std::stable_sort (entries.begin (), entries.end (),
+            [] (auto const& a, auto const& b) { return a.ndx < b.ndx; });
+    entries.erase (entries.begin (), std::unique (entries.rbegin (), entries.rend (),
+            [] (auto const& a, auto const& b) { return a.ndx == b.ndx; }).base ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static bool
+read_json_book (std::string const& source, read_book_t& book)
+{
+    int maj;
+    journal_version (&maj, nullptr, nullptr, nullptr);
+
+    std::ifstream fi (source, std::ios::binary);
+    if (!fi.is_open ())
+    {
+        log (log_level::error) << "Unable to open " << source << " for reading." << std::endl;
+        return false;
+    }
+
+    book_reader reader;
+    nlohmann::json::sax_parse (fi, &reader, input_format (encoding_of (source)));
+    fi.close ();
+
+    if (reader.major != maj)
+    {
+        log (log_level::warning) << "Incompatible book version." << std::endl;
+        return false;
+    }
+
+    auto& entries = reader.entries;
+    sort_entries (entries);
+
+    for (auto& e: entries)
+        if (e.has_image && !e.image_file.empty ())
+            obtain_image (e.image_file, e.page.image);
+
+    book.pages.reserve (entries.size ());
+    for (auto& e: entries)
+        book.pages.emplace_back (std::move (e.page));
+    book.sources.assign (book.pages.size (), std::size_t (-1));
+    book.current = reader.current;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+load_book (std::string const& source)
+{
+    profile_scope scope ("load_book");
+    try
+    {
+        read_book_t book;
+        if (!(is_jbook (source) ? read_jbook (source, book) : read_json_book (source, book)))
+            return false;
 
-        journal.pages.clear ();
-        journal.pages.reserve (pages.size ());
-        for (auto const& kv: pages)
-            journal.pages.emplace_back (std::move (kv.second));
+        std::size_t log_size;
+        bool log_complete = replay_edit_log (source, book, log_size,
+                log (log_level::warning), true);
 
-        while (journal.pages.size () < 2)
+        // Not in the log, so the book on disk has fewer pages than later records may refer to
+        bool padded = false;
+        while (book.pages.size () < 2)
         {
-            log () << "Less than two pages. Inserting empty one." << std::endl;
-            journal.pages.emplace_back (page_t {});
+            log (log_level::warning) << "Less than two pages. Inserting empty one." << std::endl;
+            book.insert (book.pages.size ());
+            padded = true;
         }
 
-        if (current >= journal.pages.size ())
+        if (book.current >= book.pages.size ())
         {
-            log () << "Current page seems off. Setting it to the first one." << std::endl;
-            current = 0;
+            log (log_level::warning) << "Current page seems off. Setting it to the first one."
+                                     << std::endl;
+            book.current = 0;
         }
-        journal.current_page = current;
+        scope.arg ("pages", book.pages.size ());
+        scope.arg ("log bytes", log_size);
+        journal.pages = std::move (book.pages);
+        journal.current_page = book.current;
+        book_replaced (std::move (book.mapped), book.sources);
+        // A sound log is kept growing, a broken one (or a padded book) is left for the next save
+        // to compact away
+        if (log_complete && !padded)
+            book_saved (source, log_size);
     }
     catch (std::exception const& ex)
     {
-        log () << "Unable to load book: " << ex.what () << std::endl;
+        log (log_level::error) << "Unable to load book: " << ex.what () << std::endl;
         return false;
     }
     return true;
@@ -226,16 +914,61 @@ load_book (std::string const& source)
 
 //--------------------------------------------------------------------------------------------------
 
+void
+load_default_book (std::string const& source)
+{
+    // A loaded book is padded and replaced already, doing it again would forget its edit log
+    if (load_book (source))
+        return;
+    journal.pages.clear ();
+    journal.pages.resize (2);
+    journal.current_page = 0;
+    book_replaced ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+template<class Writer>
 static void
-save_font (nlohmann::json& json, font_t const& font)
+save_font (Writer& json, font_t const& font)
 {
-    auto& jf = json[font.name + " font"];
-    jf["scale"] = font.imfont->Scale;
-    jf["color"] = hex_string (font.color);
-    jf["size"] = font.imfont->FontSize;
-    jf["file"] = font.file;
-    jf["glyphs"] = font.glyphs;
-    jf["ranges"] = font.ranges;
+    json.key (font.name + " font").begin_object ()
+        .key ("color").value (hex_string (font.color))
+        .key ("file").value (font.file)
+        .key ("glyphs").value (font.glyphs)
+        .key ("ranges").begin_array ();
+    for (auto r: font.ranges) json.value (r);
+    json.end_array ()
+        .key ("scale").value (font.imfont->Scale)
+        .key ("size").value (font.imfont->FontSize)
+        .end_object ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// As in the settings file, by log_level
+static const std::array<const char*, 4> log_level_names = { "debug", "info", "warning", "error" };
+
+/// In the key order of the nlohmann generated files
+
+template<class Writer>
+static void
+write_settings_keys (Writer& json)
+{
+    json.begin_object ()
+        .key ("background").begin_object ()
+            .key ("file").value (journal.background_file)
+        .end_object ();
+    save_font (json, journal.button_font);
+    save_font (json, journal.chapter_font);
+    json.key ("edit log").value (journal.edit_log);
+    json.key ("freeze variables").value (journal.freeze_variables);
+    json.key ("log level").value (log_level_names[std::size_t (log_threshold ())]);
+    save_font (json, journal.default_font);
+    save_font (json, journal.text_font);
+    json.key ("titlebar").value (journal.show_titlebar);
+    write_version (json);
+    json.end_object ();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -243,40 +976,34 @@ save_font (nlohmann::json& json, font_t const& font)
 bool
 save_settings ()
 {
-    int maj, min, patch;
-    const char* timestamp;
-    journal_version (&maj, &min, &patch, &timestamp);
-
+    profile_scope scope ("save_settings");
     try
     {
-        nlohmann::json json = {
-            { "version", {
-                { "major", maj },
-                { "minor", min },
-                { "patch", patch },
-                { "timestamp", timestamp }
-            }},
-        };
-
-        json["titlebar"] = journal.show_titlebar;
-        json["background"]["file"] = journal.background_file;
-        save_font (json, journal.text_font);
-        save_font (json, journal.chapter_font);
-        save_font (json, journal.button_font);
-        save_font (json, journal.default_font);
-
-        std::ofstream of (settings_location);
+        auto e = encoding_of (settings_location);
+        std::ofstream of (settings_location, e == encoding::json ? std::ios::out : std::ios::binary);
         if (!of.is_open ())
         {
-            log () << "Unable to open " << settings_location << " for writting." << std::endl;
+            log (log_level::error) << "Unable to open " << settings_location << " for writting."
+                                   << std::endl;
             return false;
         }
 
-        of << json.dump (4);
+        if (e != encoding::json)
+        {
+            json_builder json;
+            write_settings_keys (json);
+            json.write (of, e);
+        }
+        else
+        {
+            json_writer json (of);
+            write_settings_keys (json);
+            json.flush ();
+        }
     }
     catch (std::exception const& ex)
     {
-        log () << "Unable to save settings file: " << ex.what () << std::endl;
+        log (log_level::error) << "Unable to save settings file: " << ex.what () << std::endl;
         return false;
     }
     return true;
@@ -309,6 +1036,10 @@ load_font (nlohmann::json const& json, font_t& font)
         font.file = journal_directory + font.name + ".ttf";
     font.ranges = jf.value ("ranges", std::vector<ImWchar> {});
 
+    // Only added to the atlas here, the glyphs are rendered when the atlas gets built later
+    profile_scope scope ("load_font");
+    scope.arg ("size", std::uint64_t (font.size));
+
     auto font_atlas = imgui.igGetIO ()->Fonts;
     ImWchar const* ranges = nullptr;
     if (font.ranges.size ())
@@ -352,9 +1083,31 @@ load_font (nlohmann::json const& json, font_t& font)
 
 //--------------------------------------------------------------------------------------------------
 
+/// The settings are read from and written to whichever of the JSON, CBOR or MessagePack files
+/// (same name, other extension) exists, JSON if none
+
+static void
+locate_settings ()
+{
+    if (file_exists (settings_location))
+        return;
+    auto dot = settings_location.rfind ('.');
+    if (dot == std::string::npos || dot < settings_location.find_last_of ("\\/") + 1)
+        return;
+    auto stem = settings_location.substr (0, dot);
+    for (auto ext: { ".json", ".cbor", ".msgpack" })
+        if (file_exists (stem + ext))
+        {
+            settings_location = stem + ext;
+            return;
+        }
+}
+
 bool
 load_settings ()
 {
+    profile_scope scope ("load_settings");
+    locate_settings ();
     int maj;
     journal_version (&maj, nullptr, nullptr, nullptr);
 
@@ -362,17 +1115,21 @@ load_settings ()
     {
         nlohmann::json json;
 
-        std::ifstream fi (settings_location);
+        std::ifstream fi (settings_location, std::ios::binary);
         if (!fi.is_open ())
         {
-            log () << "Unable to open " << settings_location << " for reading." << std::endl;
+            log (log_level::error) << "Unable to open " << settings_location << " for reading."
+                                   << std::endl;
         }
         else
         {
-            fi >> json;
+            auto e = encoding_of (settings_location);
+            if (e == encoding::cbor) json = nlohmann::json::from_cbor (fi);
+            else if (e == encoding::msgpack) json = nlohmann::json::from_msgpack (fi);
+            else fi >> json;
             if (json["version"]["major"].get<int> () != maj)
             {
-                log () << "Incompatible settings file." << std::endl;
+                log (log_level::warning) << "Incompatible settings file." << std::endl;
                 return false;
             }
         }
@@ -427,10 +1184,17 @@ load_settings ()
             journal.background_file = json["background"].value ("file", journal.background_file);
 
         journal.show_titlebar = json.value ("titlebar", false);
+        journal.edit_log = json.value ("edit log", false);
+        journal.freeze_variables = json.value ("freeze variables", false);
+
+        auto level = json.value ("log level", std::string ("info"));
+        auto known = std::find (log_level_names.begin (), log_level_names.end (), level);
+        set_log_threshold (known == log_level_names.end () ? log_level::info
+                : log_level (known - log_level_names.begin ()));
     }
     catch (std::exception const& ex)
     {
-        log () << "Unable to load settings file: " << ex.what () << std::endl;
+        log (log_level::error) << "Unable to load settings file: " << ex.what () << std::endl;
         return false;
     }
     return true;
@@ -438,56 +1202,101 @@ load_settings ()
 
 //--------------------------------------------------------------------------------------------------
 
+/// The K in a "{prefix}K" node name, in the same form as std::to_string() would write it, else 0
+
+static std::size_t
+takenotes_slot (std::string_view name, std::string_view prefix)
+{
+    if (!name.starts_with (prefix))
+        return 0;
+    name.remove_prefix (prefix.size ());
+    if (name.empty () || name.front () == '0')
+        return 0;
+    std::size_t k;
+    auto [end, ec] = std::from_chars (name.data (), name.data () + name.size (), k);
+    if (ec != std::errc () || end != name.data () + name.size ())
+        return 0;
+    return k;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Throws on failure, the problems which are not are reported to \p messages
+
+static std::vector<page_t>
+read_takenotes (std::string const& source, std::ostream& messages)
+{
+    std::ifstream fi (source);
+    if (!fi.is_open ())
+        throw std::runtime_error ("Unable to open " + source + " for reading.");
+
+    std::string content {std::istreambuf_iterator<char> (fi),
+                         std::istreambuf_iterator<char> ()};
+    // Shown anyway, ImGui replaces what it can not decode
+    if (!valid_utf8 (content))
+        messages << "Take Notes file " << source << " is not valid UTF-8." << std::endl;
+
+    using namespace rapidxml;
+    xml_document<> doc;
+    doc.parse<0> (&content[0]);
+    auto fiss = doc.first_node ("fiss");
+    if (!fiss) throw std::runtime_error ("No /fiss node");
+    auto data = fiss->first_node ("Data");
+    if (!data) throw std::runtime_error ("No /fiss/Data node");
+    auto noe = data->first_node ("NumberOfEntries");
+    if (!noe) throw std::runtime_error ("No /fiss/Data/NumberOfEntries node");
+    auto n = (int) std::stoul (noe->value ());
+
+    // One pass over the nodes, the first "dateK" and "entryK" going to the K-th slot
+    std::vector<std::pair<xml_node<>*, xml_node<>*>> slots (std::max (n, 0));
+    for (auto node = data->first_node (); node; node = node->next_sibling ())
+    {
+        std::string_view name (node->name (), node->name_size ());
+        auto slot = takenotes_slot (name, "date");
+        bool title = slot != 0;
+        if (!title)
+            slot = takenotes_slot (name, "entry");
+        if (!slot || slot > slots.size ())
+            continue;
+        auto& s = title ? slots[slot-1].first : slots[slot-1].second;
+        if (!s) s = node;
+    }
+
+    std::vector<page_t> pages (std::max (n, 2));
+    for (int i = 0; i < n; ++i)
+    {
+        auto [title, entry] = slots[i];
+        if (!title || !entry) continue; // Turns out there can be holes
+        pages[i].title = title->value ();
+        pages[i].content = entry->value ();
+    }
+    return pages;
+}
+
+//--------------------------------------------------------------------------------------------------
+
 bool
 load_takenotes (std::string const& source)
 {
+    profile_scope scope ("load_takenotes");
     try
     {
-        std::ifstream fi (source);
-        if (!fi.is_open ())
-        {
-            log () << "Unable to open " << source << " for reading." << std::endl;
-            return false;
-        }
-
-        std::string content {std::istreambuf_iterator<char> (fi),
-                             std::istreambuf_iterator<char> ()};
-
-        using namespace rapidxml;
-        xml_document<> doc;
-        doc.parse<0> (&content[0]);
-        auto fiss = doc.first_node ("fiss");
-        if (!fiss) throw std::runtime_error ("No /fiss node");
-        auto data = fiss->first_node ("Data");
-        if (!data) throw std::runtime_error ("No /fiss/Data node");
-        auto noe = data->first_node ("NumberOfEntries");
-        if (!noe) throw std::runtime_error ("No /fiss/Data/NumberOfEntries node");
-        auto n = (int) std::stoul (noe->value ());
-
-        std::vector<page_t> pages (std::max (n, 2));
-        for (int i = 0; i < n; ++i)
-        {
-            auto num = std::to_string (i+1);
-            auto title = data->first_node (("date" + num).c_str ());
-            if (!title) continue; // Turns out there can be holes
-            auto entry = data->first_node (("entry" + num).c_str ());
-            if (!entry) continue;
-            pages[i].title = title->value ();
-            pages[i].content = entry->value ();
-        }
+        auto pages = read_takenotes (source, log (log_level::warning));
 
         while (pages.size () < 2)
         {
-            log () << "Less than two pages. Inserting empty one." << std::endl;
+            log (log_level::warning) << "Less than two pages. Inserting empty one." << std::endl;
             pages.emplace_back (page_t {});
         }
 
+        scope.arg ("pages", pages.size ());
         journal.pages = std::move (pages);
         journal.current_page = 0;
+        book_replaced ();
     }
     catch (std::exception const& ex)
     {
-        log () << "Unable to load Take Notes XML file: " << ex.what () << std::endl;
+        log (log_level::error) << "Unable to load Take Notes XML file: " << ex.what () << std::endl;
         return false;
     }
     return true;
@@ -495,9 +1304,64 @@ load_takenotes (std::string const& source)
 
 //--------------------------------------------------------------------------------------------------
 
+/**
+ * Reads the texts of a book file, Take Notes XML ones included, with its edit log replayed.
+ *
+ * Unlike load_book() nothing global is touched, no images are obtained and binary books are
+ * read in full, so this is safe to call from any thread.
+ *
+ * @param messages where the problems which did not stop the reading are reported
+ * @throws std::exception if the book could not be read
+ */
+
+std::vector<page_t>
+read_book_pages (std::string const& source, std::ostream& messages)
+{
+    if (source.ends_with (".xml"))
+        return read_takenotes (source, messages);
+
+    int maj;
+    journal_version (&maj, nullptr, nullptr, nullptr);
+
+    read_book_t book;
+    if (is_jbook (source))
+    {
+        mapped_book mapped (source);
+        if (int (mapped.header ().major) != maj)
+            throw std::runtime_error ("Incompatible book version.");
+        book.pages.resize (mapped.size ());
+        for (std::size_t i = 0; i < book.pages.size (); ++i)
+        {
+            book.pages[i].title = mapped.text (mapped.page (i).title);
+            book.pages[i].content = mapped.text (mapped.page (i).content);
+        }
+    }
+    else
+    {
+        std::ifstream fi (source, std::ios::binary);
+        if (!fi.is_open ())
+            throw std::runtime_error ("Unable to open " + source + " for reading.");
+        book_reader reader;
+        nlohmann::json::sax_parse (fi, &reader, input_format (encoding_of (source)));
+        if (reader.major != maj)
+            throw std::runtime_error ("Incompatible book version.");
+        sort_entries (reader.entries);
+        for (auto& e: reader.entries)
+            book.pages.emplace_back (std::move (e.page));
+    }
+
+    book.sources.assign (book.pages.size (), std::size_t (-1));
+    std::size_t bytes;
+    replay_edit_log (source, book, bytes, messages, false);
+    return std::move (book.pages);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 bool
 save_variables ()
 {
+    profile_scope scope ("save_variables");
     try
     {
         nlohmann::json json;
@@ -512,14 +1376,15 @@ save_variables ()
         std::ofstream of (variables_location);
         if (!of.is_open ())
         {
-            log () << "Unable to open " << variables_location << " for writting." << std::endl;
+            log (log_level::error) << "Unable to open " << variables_location << " for writting."
+                                   << std::endl;
             return false;
         }
         of << json.dump (4);
     }
     catch (std::exception const& ex)
     {
-        log () << "Unable to save variables file: " << ex.what () << std::endl;
+        log (log_level::error) << "Unable to save variables file: " << ex.what () << std::endl;
         return false;
     }
     return true;
@@ -530,13 +1395,15 @@ save_variables ()
 bool
 load_variables ()
 {
+    profile_scope scope ("load_variables");
     try
     {
         nlohmann::json json;
 
         std::ifstream fi (variables_location);
         if (!fi.is_open ())
-            log () << "Unable to open " << variables_location << " for reading." << std::endl;
+            log (log_level::error) << "Unable to open " << variables_location << " for reading."
+                                   << std::endl;
         else
             fi >> json;
 
@@ -570,7 +1437,7 @@ load_variables ()
     }
     catch (std::exception const& ex)
     {
-        log () << "Unable to load variables file: " << ex.what () << std::endl;
+        log (log_level::error) << "Unable to load variables file: " << ex.what () << std::endl;
         return false;
     }
     return true;
@@ -0,0 +1,161 @@
+/**
+ * @file gamestate.cpp
+ * @brief What the variables read from the game memory, taken once per frame
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The pointer chains are followed once per frame, on the first game_state() call after
+ * tick_game_state(), and all variables format from that snapshot. Each link of a chain is
+ * checked to look like a pointer before it is followed, so a half-built game object (as in
+ * the Main Menu) gives "not available" rather than a crash, most of the time.
+ *
+ * Nothing here knows of Windows: the plugin points #game_memory at SkyrimSE.exe (see
+ * variables.cpp), the bench at a mock image with the same layout.
+ */
+
+#include "sse-journal.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+//--------------------------------------------------------------------------------------------------
+
+game_memory_t game_memory = {};
+
+static game_state_t state = {};
+
+/// Bumped each frame, the state is taken again when it differs from state.tick
+static unsigned tick = 1;
+
+/// Longer names are cut, also not to read too far past a bad pointer
+constexpr std::size_t max_name = 256;
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+plausible_pointer (std::uintptr_t p, std::size_t alignment)
+{
+    // Past the first 64K, which Windows never maps, and in the 47 bits user space
+    return p >= 0x10000 && p < (std::uintptr_t (1) << 47) && p % alignment == 0;
+}
+
+static void
+copy_name (std::string& name, const char* source)
+{
+    if (!source)
+        return name.clear ();
+    name.assign (source, std::find (source, source + max_name, '\0'));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+tick_game_state ()
+{
+    ++tick;
+}
+
+game_state_t const&
+game_state ()
+{
+    if (state.tick == tick)
+        return state;
+    state.tick = tick;
+
+    auto epoch = game_memory.epoch.obtain (game_memory.base);
+    state.has_epoch = epoch != nullptr;
+    state.epoch = epoch ? *epoch : 0.f;
+
+    auto pos = game_memory.position.obtain (game_memory.base);
+    state.has_position = pos && std::isfinite (pos[0]) && std::isfinite (pos[1])
+                      && std::isfinite (pos[2]);
+    if (state.has_position)
+        std::copy (pos, pos + 3, state.position.begin ());
+    else
+        state.position = {};
+
+    copy_name (state.cell, game_memory.cell.obtain (game_memory.base));
+    copy_name (state.worldspace, game_memory.worldspace.obtain (game_memory.base));
+    return state;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+compile_player_location (format_program& program, std::string_view format)
+{
+    program.compile (format, { "x", "y", "z", "cx", "cy", "wn", "cn" });
+}
+
+void
+player_location (std::string& out, format_program const& program, game_state_t const& gs)
+{
+    out.clear ();
+    if (!gs.has_position)
+    {
+        out = "(n/a)";
+        return;
+    }
+
+    program.run (out, [&gs] (int substitution, std::string& text) {
+        char buff[32];
+        switch (substitution)
+        {
+            case 0: case 1: case 2:
+                text.append (buff, std::snprintf (buff, sizeof (buff), "%.0f",
+                            gs.position[substitution]));
+                break;
+            case 3: case 4:
+            {
+                int cell = int (std::floor (gs.position[substitution - 3]/4096));
+                text.append (buff, std::to_chars (buff, buff + sizeof (buff), cell).ptr);
+                break;
+            }
+            case 5: text += gs.worldspace; break;
+            case 6: text += gs.cell; break;
+        }
+    });
+}
+
+void
+player_location_inputs (std::string& key, game_state_t const& gs)
+{
+    if (!gs.has_position)
+    {
+        key += '-';
+        return;
+    }
+    // As shown: whole units and cells, then the names
+    std::array<float, 5> shown;
+    for (int i = 0; i < 3; ++i)
+        shown[i] = std::nearbyint (gs.position[i]);
+    for (int i = 0; i < 2; ++i)
+        shown[3 + i] = std::floor (gs.position[i]/4096);
+    key.append (reinterpret_cast<const char*> (shown.data ()), sizeof (shown));
+    key.append (gs.worldspace.c_str (), gs.worldspace.size () + 1);
+    key.append (gs.cell.c_str (), gs.cell.size () + 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
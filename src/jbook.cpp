@@ -0,0 +1,200 @@
+/**
+ * @file jbook.cpp
+ * @brief Binary journal books, suitable to be memory mapped
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * A binary book holds the same data as the JSON one: a header, a table with fixed size entry for
+ * each page, and then all the texts. Every text is followed by a zero, so it can be used as C
+ * string too. Mapping the file gives direct access to any page, without parsing the others.
+ * All offsets and sizes are checked when the file is mapped, so a damaged book is rejected
+ * instead of being read past its end.
+ */
+
+#include "sse-journal.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+//--------------------------------------------------------------------------------------------------
+
+static_assert (sizeof (jbook_header) == 40 && sizeof (jbook_page) == 88,
+        "Binary book layout must not depend on the compiler");
+
+/// Eight bytes, so that the rest of the header stays aligned
+static constexpr char jbook_magic[8] = { 'S', 'S', 'E', 'J', 'B', 'O', 'O', 'K' };
+
+/// Increased with any change of the layout
+static constexpr std::uint32_t jbook_format = 1;
+
+/// Paths of the books mapped now, for the saving to wait until the one it replaces is let go of
+struct mapped_files_t
+{
+    std::mutex lock;
+    std::condition_variable released;
+    std::vector<std::string> paths;
+};
+
+/// Never destroyed, as the detached workers may still unmap books at exit
+static mapped_files_t& mapped_files = *new mapped_files_t {};
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+is_jbook (std::string const& file)
+{
+    constexpr std::string_view ext = ".jbook";
+    return file.size () >= ext.size () && file.compare (file.size () - ext.size (), ext.size (),
+            ext.data (), ext.size ()) == 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+mapped_book::mapped_book (std::string const& name)
+    : file_path (name), view (nullptr), view_size (0)
+{
+    view = map_file (name, view_size);
+    auto fail = [this, &name] (std::string const& what)
+    {
+        unmap_file (view, view_size);
+        throw std::runtime_error (name + ": " + what);
+    };
+
+    if (view_size < sizeof (jbook_header))
+        fail ("Too small for a binary book.");
+
+    auto const& h = header ();
+    if (std::memcmp (h.magic, jbook_magic, sizeof (jbook_magic)))
+        fail ("Not a binary book.");
+    if (h.format != jbook_format)
+        fail ("Unknown binary book format " + std::to_string (h.format) + ".");
+    if (h.pages > view_size || h.pages % alignof (jbook_page)
+            || (view_size - h.pages) / sizeof (jbook_page) < h.size)
+        fail ("Page table out of the file.");
+
+    auto valid = [this] (jbook_blob const& b)
+    {
+        return b.offset < view_size && b.size < view_size - b.offset
+            && view[b.offset + b.size] == '\0';
+    };
+    for (std::size_t i = 0; i < h.size; ++i)
+    {
+        auto const& p = page (i);
+        if (!valid (p.title) || !valid (p.content) || !valid (p.image_file))
+            fail ("Page #" + std::to_string (i) + " out of the file.");
+    }
+
+    std::lock_guard<std::mutex> lock (mapped_files.lock);
+    mapped_files.paths.push_back (file_path);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+mapped_book::~mapped_book ()
+{
+    unmap_file (view, view_size);
+
+    std::lock_guard<std::mutex> lock (mapped_files.lock);
+    auto& paths = mapped_files.paths;
+    paths.erase (std::find (paths.begin (), paths.end (), file_path));
+    mapped_files.released.notify_all ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+wait_unmapped (std::string const& file, unsigned timeout)
+{
+    std::unique_lock<std::mutex> lock (mapped_files.lock);
+    auto& paths = mapped_files.paths;
+    return mapped_files.released.wait_for (lock, std::chrono::milliseconds (timeout), [&] {
+        return std::find (paths.begin (), paths.end (), file) == paths.end ();
+    });
+}
+
+//--------------------------------------------------------------------------------------------------
+
+jbook_page const&
+mapped_book::page (std::size_t ndx) const
+{
+    return reinterpret_cast<jbook_page const*> (view + header ().pages)[ndx];
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Throws on failure, can be called from any thread
+
+void
+write_jbook (book_snapshot_t const& book, std::ostream& os)
+{
+    jbook_header h {};
+    std::memcpy (h.magic, jbook_magic, sizeof (jbook_magic));
+    h.format = jbook_format;
+    int maj, min, patch;
+    journal_version (&maj, &min, &patch, nullptr);
+    h.major = maj;
+    h.minor = min;
+    h.patch = patch;
+    h.current = book.current;
+    h.size = std::uint32_t (book.pages.size ());
+    h.pages = sizeof (h);
+
+    // Texts are laid out in the page order: title, content, image file
+    std::uint64_t offset = h.pages + book.pages.size () * sizeof (jbook_page);
+    auto place = [&offset] (std::string_view s)
+    {
+        jbook_blob b { offset, s.size () };
+        offset += s.size () + 1;
+        return b;
+    };
+
+    std::vector<jbook_page> table;
+    table.reserve (book.pages.size ());
+    for (auto const& p: book.pages)
+    {
+        jbook_page e {};
+        e.title = place (p.title.view);
+        e.content = place (p.content.view);
+        e.image_file = place (p.image_file);
+        e.background = p.image.background;
+        e.tint = p.image.tint;
+        e.uv = p.image.uv;
+        e.xy = p.image.xy;
+        table.push_back (e);
+    }
+
+    os.write (reinterpret_cast<const char*> (&h), sizeof (h));
+    os.write (reinterpret_cast<const char*> (table.data ()), table.size () * sizeof (jbook_page));
+    for (auto const& p: book.pages)
+        for (std::string_view s: { p.title.view, p.content.view, std::string_view (p.image_file) })
+        {
+            os.write (s.data (), s.size ());
+            os.put ('\0');
+        }
+}
+
+//--------------------------------------------------------------------------------------------------
+
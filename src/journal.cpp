@@ -0,0 +1,60 @@
+/**
+ * @file journal.cpp
+ * @brief State shared between the SKSE plugin and the journal core
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Nothing here depends on Windows, SKSE or a running game. The plugin fills in the API tables
+ * once SSE-ImGui is there, while the tools built over the core put their own stand-ins.
+ */
+
+#include "sse-journal.hpp"
+
+//--------------------------------------------------------------------------------------------------
+
+journal_t journal = {};
+
+/// [shared] Local initialization
+sseimgui_api sseimgui = {};
+
+/// [shared] Table with pointers
+imgui_api imgui = {};
+
+/// [shared] Reports current log file path (for user friendly messages)
+std::string logfile_path;
+
+//--------------------------------------------------------------------------------------------------
+
+void
+journal_version (int* maj, int* min, int* patch, const char** timestamp)
+{
+    constexpr std::array<int, 3> ver = {
+#include "../VERSION"
+    };
+    if (maj) *maj = ver[0];
+    if (min) *min = ver[1];
+    if (patch) *patch = ver[2];
+    if (timestamp) *timestamp = JOURNAL_TIMESTAMP; //"2019-04-15T08:37:11.419416+00:00"
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,295 @@
+/**
+ * @file jsonwriter.cpp
+ * @brief Streaming JSON output, without building a document in memory first
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The output mimics nlohmann::json::dump() byte for byte (in both the indented and the compact
+ * form), so files written by older versions do not change, if the content did not change. Note
+ * that the keys are written in the order given, while nlohmann sorts them.
+ */
+
+#include "sse-journal.hpp"
+
+#include <charconv>
+#include <stdexcept>
+#include <cmath>
+
+#if defined(__GNUC__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wformat="
+#  pragma GCC diagnostic ignored "-Wformat-extra-args"
+#  include <nlohmann/json.hpp>
+#  pragma GCC diagnostic pop
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+json_writer::json_writer (std::ostream& os, style s)
+    : os (os), indent (s == style::pretty ? 4 : 0)
+{
+    buffer.reserve (buffer_size);
+}
+
+json_writer::~json_writer ()
+{
+    try { flush (); }
+    catch (...) {}
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+json_writer::flush ()
+{
+    if (buffer.empty ())
+        return;
+    os.write (buffer.data (), std::streamsize (buffer.size ()));
+    buffer.clear ();
+    if (!os)
+        throw std::runtime_error ("Unable to write JSON output");
+}
+
+inline void
+json_writer::put (std::string_view s)
+{
+    if (buffer.size () + s.size () > buffer_size)
+    {
+        flush ();
+        if (s.size () > buffer_size)
+        {
+            os.write (s.data (), std::streamsize (s.size ()));
+            return;
+        }
+    }
+    buffer.append (s);
+}
+
+inline void
+json_writer::put (char c)
+{
+    if (buffer.size () >= buffer_size)
+        flush ();
+    buffer.push_back (c);
+}
+
+inline void
+json_writer::newline ()
+{
+    auto n = indent * levels.size ();
+    if (buffer.size () + n + 1 > buffer_size)
+        flush ();
+    buffer.push_back ('\n');
+    buffer.append (n, ' ');
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// New element in the current object or array: separator and indentation, as needed
+
+void
+json_writer::element ()
+{
+    if (after_key)
+    {
+        after_key = false;
+        return;
+    }
+    if (levels.empty ())
+        return;
+    if (!levels.back ())
+        put (',');
+    levels.back () = false;
+    if (indent)
+        newline ();
+}
+
+void
+json_writer::open (char c)
+{
+    element ();
+    put (c);
+    levels.push_back (true);
+}
+
+void
+json_writer::close (char c)
+{
+    bool empty = levels.back ();
+    levels.pop_back ();
+    if (indent && !empty)
+        newline ();
+    put (c);
+}
+
+json_writer& json_writer::begin_object () { open ('{'); return *this; }
+json_writer& json_writer::end_object () { close ('}'); return *this; }
+json_writer& json_writer::begin_array () { open ('['); return *this; }
+json_writer& json_writer::end_array () { close (']'); return *this; }
+
+//--------------------------------------------------------------------------------------------------
+
+json_writer&
+json_writer::key (std::string_view k)
+{
+    element ();
+    escaped (k);
+    put (indent ? std::string_view (": ") : std::string_view (":"));
+    after_key = true;
+    return *this;
+}
+
+json_writer&
+json_writer::value (std::string_view v)
+{
+    element ();
+    escaped (v);
+    return *this;
+}
+
+json_writer&
+json_writer::value (bool v)
+{
+    element ();
+    put (v ? std::string_view ("true") : std::string_view ("false"));
+    return *this;
+}
+
+json_writer&
+json_writer::value (double v)
+{
+    element ();
+    if (!std::isfinite (v))
+    {
+        put ("null");
+        return *this;
+    }
+    std::array<char, 64> b;
+    auto end = nlohmann::detail::to_chars (b.data (), b.data () + b.size (), v);
+    put (std::string_view (b.data (), std::size_t (end - b.data ())));
+    return *this;
+}
+
+json_writer&
+json_writer::integer (long long v)
+{
+    element ();
+    std::array<char, 24> b;
+    auto r = std::to_chars (b.data (), b.data () + b.size (), v);
+    put (std::string_view (b.data (), std::size_t (r.ptr - b.data ())));
+    return *this;
+}
+
+json_writer&
+json_writer::integer (unsigned long long v)
+{
+    element ();
+    std::array<char, 24> b;
+    auto r = std::to_chars (b.data (), b.data () + b.size (), v);
+    put (std::string_view (b.data (), std::size_t (r.ptr - b.data ())));
+    return *this;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Length of a valid UTF-8 sequence at @p p, or zero if invalid (same rules as nlohmann)
+
+static std::size_t
+utf8_sequence (const unsigned char* p, const unsigned char* end)
+{
+    auto n = std::size_t (end - p);
+    auto cont = [p] (std::size_t i) { return (p[i] & 0xC0) == 0x80; };
+    unsigned c = p[0];
+    if (c >= 0xC2 && c <= 0xDF)
+        return n >= 2 && cont (1) ? 2 : 0;
+    if (c >= 0xE0 && c <= 0xEF)
+    {
+        if (n < 3 || !cont (1) || !cont (2)) return 0;
+        if (c == 0xE0 && p[1] < 0xA0) return 0; // overlong
+        if (c == 0xED && p[1] > 0x9F) return 0; // surrogates
+        return 3;
+    }
+    if (c >= 0xF0 && c <= 0xF4)
+    {
+        if (n < 4 || !cont (1) || !cont (2) || !cont (3)) return 0;
+        if (c == 0xF0 && p[1] < 0x90) return 0; // overlong
+        if (c == 0xF4 && p[1] > 0x8F) return 0; // above U+10FFFF
+        return 4;
+    }
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Quoted and escaped string, copying the untouched runs of bytes at once
+
+void
+json_writer::escaped (std::string_view s)
+{
+    put ('"');
+    auto begin = reinterpret_cast<const unsigned char*> (s.data ());
+    auto end = begin + s.size ();
+    auto run = begin;
+    for (auto p = begin; p < end; )
+    {
+        unsigned c = *p;
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\')
+        {
+            ++p;
+            continue;
+        }
+        if (c >= 0x80)
+        {
+            auto n = utf8_sequence (p, end);
+            if (!n)
+                throw std::runtime_error ("Invalid UTF-8 byte at index "
+                        + std::to_string (p - begin) + ": " + hex_string (std::uint8_t (c)));
+            p += n;
+            continue;
+        }
+
+        put (std::string_view (reinterpret_cast<const char*> (run), std::size_t (p - run)));
+        switch (c)
+        {
+            case '\b': put ("\\b"); break;
+            case '\t': put ("\\t"); break;
+            case '\n': put ("\\n"); break;
+            case '\f': put ("\\f"); break;
+            case '\r': put ("\\r"); break;
+            case '"':  put ("\\\""); break;
+            case '\\': put ("\\\\"); break;
+            default:
+            {
+                constexpr char lut[16] = {
+                    '0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f' };
+                char u[6] = { '\\', 'u', '0', '0', lut[c >> 4], lut[c & 0xF] };
+                put (std::string_view (u, sizeof (u)));
+            }
+        }
+        run = ++p;
+    }
+    put (std::string_view (reinterpret_cast<const char*> (run), std::size_t (end - run)));
+    put ('"');
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,423 @@
+/**
+ * @file library.cpp
+ * @brief Word index over all books in the books directory, kept on disk between the games
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * For each book file (Take Notes ones included) the page titles and the pages each word is found
+ * in. Words are the runs of ASCII letters and digits and of non-ASCII bytes, so the UTF-8 text of
+ * any language splits at least at the spaces and punctuation, with the ASCII letters in lower
+ * case. A query matches the pages having, for each of its words, one starting with it.
+ *
+ * The index is refreshed on a worker when the Load window opens, reading again only the books
+ * whose file or edit log changed since, by size and modification time. It is saved to the
+ * library file after each refresh which changed anything, so the next game starts from it.
+ */
+
+#include "sse-journal.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// Warning come in a BSON parser, which is not used, and probably shouldn't be
+#if defined(__GNUC__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wformat="
+#  pragma GCC diagnostic ignored "-Wformat-extra-args"
+#  include <nlohmann/json.hpp>
+#  pragma GCC diagnostic pop
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+/// Bumped when the library file layout changes, the older ones are then built anew
+constexpr int library_format = 1;
+
+/// Longer words are cut, it is the prefixes which are looked up anyway
+constexpr std::size_t max_word = 32;
+
+/// The known book types
+static const std::array<const char*, 5> book_extensions = {
+    ".json", ".jbook", ".cbor", ".msgpack", ".xml" };
+
+struct library_book_t
+{
+    std::string file;               ///< Name in the books directory
+    std::uint64_t size, mtime;
+    std::uint64_t log_size, log_mtime;  ///< Of the edit log, zeros if there is none
+    std::vector<std::string> titles;
+    /// Ascending page numbers by word, sorted so the words with a prefix are next to each other
+    std::map<std::string, std::vector<std::uint32_t>> words;
+};
+
+/// Immutable once published, the unchanged books are shared with the newer ones
+struct library_t
+{
+    std::vector<std::shared_ptr<const library_book_t>> books;   ///< By file name
+};
+
+//--------------------------------------------------------------------------------------------------
+
+static inline bool
+is_word_byte (char c)
+{
+    auto u = std::uint8_t (c);
+    return u >= 0x80 || (u >= '0' && u <= '9') || ((u | 0x20) >= 'a' && (u | 0x20) <= 'z');
+}
+
+/// Calls @p f with each word of @p text of at least two bytes, in lower case and cut to max_word
+
+template<class F>
+static void
+for_each_word (std::string_view text, F&& f)
+{
+    std::string word;
+    for (std::size_t i = 0; i < text.size (); )
+    {
+        if (!is_word_byte (text[i]))
+        {
+            ++i;
+            continue;
+        }
+        word.clear ();
+        for (; i < text.size () && is_word_byte (text[i]); ++i)
+            if (word.size () < max_word)
+                word += text[i] >= 'A' && text[i] <= 'Z' ? char (text[i] - 'A' + 'a') : text[i];
+        // Not splitting an UTF-8 sequence at the cut
+        if (word.size () == max_word)
+            while (!word.empty () && (std::uint8_t (word.back ()) & 0xC0) == 0x80)
+                word.pop_back ();
+        if (word.size () >= 2)
+            f (word);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+index_book (library_book_t& book, std::vector<page_t> const& pages)
+{
+    // Hashed while collecting, as most words repeat, sorted once at the end
+    std::unordered_map<std::string, std::vector<std::uint32_t>> words;
+    book.titles.clear ();
+    for (std::size_t i = 0; i < pages.size (); ++i)
+    {
+        auto page = std::uint32_t (i);
+        auto add = [&words, page] (std::string const& word)
+        {
+            auto& list = words[word];
+            if (list.empty () || list.back () != page)
+                list.push_back (page);
+        };
+        book.titles.emplace_back (pages[i].title.view ());
+        for_each_word (pages[i].title, add);
+        for_each_word (pages[i].content, add);
+    }
+    book.words.clear ();
+    for (auto& [word, list]: words)
+        book.words.emplace (word, std::move (list));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+save_library (library_t const& library)
+{
+    auto books = nlohmann::json::array ();
+    for (auto const& b: library.books)
+        books.push_back ({
+            { "file", b->file },
+            { "size", b->size },
+            { "mtime", b->mtime },
+            { "log size", b->log_size },
+            { "log mtime", b->log_mtime },
+            { "titles", b->titles },
+            { "words", b->words } });
+    nlohmann::json json = { { "format", library_format }, { "books", std::move (books) } };
+
+    // Written aside first, a torn library file is worse than an outdated one
+    auto temporary = library_location + ".tmp";
+    {
+        std::ofstream of (temporary, std::ios::binary);
+        if (!of.is_open ())
+            throw std::runtime_error ("Unable to open " + temporary + " for writting.");
+        nlohmann::json::to_msgpack (json, of);
+        of.close ();
+        if (!of)
+            throw std::runtime_error ("Unable to write " + temporary + ".");
+    }
+    replace_file (temporary, library_location);
+}
+
+/// An empty library if there is no file yet, throws if it is unusable
+
+static library_t
+load_library ()
+{
+    library_t library;
+    std::ifstream fi (library_location, std::ios::binary);
+    if (!fi.is_open ())
+        return library;
+
+    auto json = nlohmann::json::from_msgpack (fi);
+    if (json.value ("format", 0) != library_format)
+        return library;
+    for (auto const& jb: json["books"])
+    {
+        auto b = std::make_shared<library_book_t> ();
+        b->file = jb["file"];
+        b->size = jb["size"];
+        b->mtime = jb["mtime"];
+        b->log_size = jb["log size"];
+        b->log_mtime = jb["log mtime"];
+        b->titles = jb["titles"].get<std::vector<std::string>> ();
+        b->words = jb["words"].get<std::map<std::string, std::vector<std::uint32_t>>> ();
+        library.books.push_back (std::move (b));
+    }
+    std::sort (library.books.begin (), library.books.end (),
+            [] (auto const& a, auto const& b) { return a->file < b->file; });
+    return library;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Background refreshing, alike to the book saving: at most one running, and one waiting
+
+struct librarian_t
+{
+    std::mutex lock;
+    std::condition_variable wake;
+    bool started;
+    unsigned requested, finished;
+    std::shared_ptr<const library_t> library;   ///< Last published, null until the first refresh
+    std::string messages;                       ///< Not logged yet
+};
+
+/// Never destroyed, as the detached worker may still wait on it at exit
+static librarian_t& librarian = *new librarian_t {};
+
+/// Reads again the changed books, the unchanged ones are taken over from @p old
+
+static library_t
+refresh_library (library_t const& old, std::ostream& messages, bool& changed)
+{
+    std::vector<file_info_t> files;
+    for (auto extension: book_extensions)
+    {
+        auto found = list_files (books_directory, extension);
+        std::move (found.begin (), found.end (), std::back_inserter (files));
+    }
+    std::sort (files.begin (), files.end (),
+            [] (auto const& a, auto const& b) { return a.name < b.name; });
+
+    library_t library;
+    changed = files.size () != old.books.size ();
+    auto known = old.books.begin ();
+    for (auto const& f: files)
+    {
+        file_info_t log_info { {}, 0, 0 };
+        file_info (edit_log_file (books_directory + f.name), log_info);
+
+        while (known != old.books.end () && (*known)->file < f.name)
+            ++known;
+        if (known != old.books.end () && (*known)->file == f.name
+                && (*known)->size == f.size && (*known)->mtime == f.mtime
+                && (*known)->log_size == log_info.size && (*known)->log_mtime == log_info.mtime)
+        {
+            library.books.push_back (*known);
+            continue;
+        }
+
+        changed = true;
+        auto b = std::make_shared<library_book_t> ();
+        b->file = f.name;
+        b->size = f.size;
+        b->mtime = f.mtime;
+        b->log_size = log_info.size;
+        b->log_mtime = log_info.mtime;
+        try
+        {
+            index_book (*b, read_book_pages (books_directory + f.name, messages));
+        }
+        catch (std::exception const& ex)
+        {
+            // Kept empty, so it is not read (and reported) again until it changes
+            messages << "Unable to index book " << f.name << ": " << ex.what () << std::endl;
+            b->titles.clear ();
+            b->words.clear ();
+        }
+        library.books.push_back (std::move (b));
+    }
+    return library;
+}
+
+static void
+librarian_loop ()
+{
+    std::unique_lock<std::mutex> lock (librarian.lock);
+    for (;;)
+    {
+        librarian.wake.wait (lock, [] { return librarian.requested != librarian.finished; });
+        auto old = librarian.library;
+        auto ticket = librarian.requested;
+        lock.unlock ();
+
+        std::ostringstream messages;
+        std::shared_ptr<const library_t> library;
+        try
+        {
+            if (!old)
+            {
+                try
+                {
+                    old = std::make_shared<const library_t> (load_library ());
+                }
+                catch (std::exception const& ex)
+                {
+                    messages << "Unable to load library file, building anew: " << ex.what ()
+                             << std::endl;
+                    old = std::make_shared<const library_t> ();
+                }
+            }
+            profile_scope scope ("refresh_library");
+            bool changed;
+            library = std::make_shared<const library_t> (refresh_library (*old, messages, changed));
+            scope.arg ("books", library->books.size ());
+            if (changed)
+                save_library (*library);
+        }
+        catch (std::exception const& ex)
+        {
+            messages << "Unable to refresh library: " << ex.what () << std::endl;
+        }
+
+        lock.lock ();
+        if (library)
+            librarian.library = std::move (library);
+        librarian.messages += messages.str ();
+        librarian.finished = ticket;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+refresh_library_async ()
+{
+    std::lock_guard<std::mutex> lock (librarian.lock);
+    if (!librarian.started)
+    {
+        // Detached, as there is no orderly DLL shutdown to join it
+        std::thread (librarian_loop).detach ();
+        librarian.started = true;
+    }
+    ++librarian.requested;
+    librarian.wake.notify_one ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+library_busy ()
+{
+    std::lock_guard<std::mutex> lock (librarian.lock);
+    if (!librarian.messages.empty ())
+    {
+        log (log_level::warning) << librarian.messages << std::flush;
+        librarian.messages.clear ();
+    }
+    return librarian.requested != librarian.finished;
+}
+
+std::size_t
+library_books ()
+{
+    std::lock_guard<std::mutex> lock (librarian.lock);
+    return librarian.library ? librarian.library->books.size () : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Ascending pages of @p book having a word starting with @p prefix
+
+static std::vector<std::uint32_t>
+pages_with_prefix (library_book_t const& book, std::string const& prefix)
+{
+    std::vector<std::uint32_t> pages, merged;
+    for (auto it = book.words.lower_bound (prefix);
+            it != book.words.end () && it->first.starts_with (prefix); ++it)
+    {
+        merged.clear ();
+        std::set_union (pages.begin (), pages.end (), it->second.begin (), it->second.end (),
+                std::back_inserter (merged));
+        pages.swap (merged);
+    }
+    return pages;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::vector<library_hit_t>
+library_search (std::string const& query, std::size_t top)
+{
+    std::vector<std::string> words;
+    for_each_word (query, [&words] (std::string const& w) { words.push_back (w); });
+
+    std::shared_ptr<const library_t> library;
+    {
+        std::lock_guard<std::mutex> lock (librarian.lock);
+        library = librarian.library;
+    }
+
+    std::vector<library_hit_t> hits;
+    if (!library || words.empty ())
+        return hits;
+
+    std::vector<std::uint32_t> common;
+    for (auto const& b: library->books)
+    {
+        auto pages = pages_with_prefix (*b, words.front ());
+        for (std::size_t i = 1; i < words.size () && !pages.empty (); ++i)
+        {
+            auto more = pages_with_prefix (*b, words[i]);
+            common.clear ();
+            std::set_intersection (pages.begin (), pages.end (), more.begin (), more.end (),
+                    std::back_inserter (common));
+            pages.swap (common);
+        }
+        for (auto page: pages)
+        {
+            if (hits.size () == top)
+                return hits;
+            hits.push_back (library_hit_t { b->file, page, b->titles.at (page) });
+        }
+    }
+    return hits;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,268 @@
+/**
+ * @file logger.cpp
+ * @brief Log lines written and flushed on a background thread
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each thread formats into its own stream, and each flush of it (std::endl included) hands the
+ * text over to a bounded lock-free queue. The writer thread takes the records in batches,
+ * prefixes them with their time, formatted once per second, and flushes the file after each
+ * batch. A full queue drops the record and counts it, rather than making the caller wait. With
+ * nothing to write the writer sleeps, until a thread handing over a record finds it asleep and
+ * wakes it, so an idle game keeps it idle too.
+ *
+ * The record strings are swapped in and out of the queue slots (see mpsc_queue), so after the
+ * first few lines nothing gets allocated on either side.
+ */
+
+#include "sse-journal.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <thread>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Lines waiting for the writer, a power of two
+constexpr std::size_t queue_size = 1024;
+
+struct log_record_t
+{
+    log_level level;
+    std::time_t time;
+    std::string text;
+};
+
+struct log_queue_t
+{
+    mpsc_queue<log_record_t, queue_size> records;
+    std::atomic<std::size_t> flushed;   ///< Records in the file so far
+    std::atomic<std::size_t> dropped;
+    std::atomic<bool> opened;
+    std::atomic<log_level> threshold { log_level::info };
+    std::atomic<bool> sleeping;         ///< The writer waits for it to be cleared
+    std::ofstream file;                 ///< Touched only by the writer, once opened
+};
+
+/// Never destroyed, as the detached writer may still use it at exit
+static log_queue_t& queue = *new log_queue_t {};
+
+//--------------------------------------------------------------------------------------------------
+
+/// The "[2019-04-15 08:37:11] " prefix, formatted again only when the second changes
+
+static std::string const&
+time_prefix (std::time_t time)
+{
+    static std::time_t cached_time = -1;
+    static std::string cached;
+    if (time != cached_time)
+    {
+        // MinGW 4.9.1 have no std::put_time()
+        auto loc_c = std::localtime (&time);
+        char buff[80];
+        std::snprintf (buff, sizeof (buff), "[%04d-%02d-%02d %02d:%02d:%02d] ",
+                1900 + loc_c->tm_year, 1 + loc_c->tm_mon, loc_c->tm_mday,
+                loc_c->tm_hour, loc_c->tm_min, loc_c->tm_sec);
+        cached = buff;
+        cached_time = time;
+    }
+    return cached;
+}
+
+static const char*
+level_prefix (log_level level)
+{
+    switch (level)
+    {
+        case log_level::debug: return "Debug: ";
+        case log_level::warning: return "Warning: ";
+        case log_level::error: return "Error: ";
+        default: return "";
+    }
+}
+
+static void
+writer_loop ()
+{
+    log_record_t record {};
+    for (;;)
+    {
+        bool written = false;
+        while (queue.records.pop (record))
+        {
+            queue.file << time_prefix (record.time) << level_prefix (record.level) << record.text;
+            record.text.clear ();
+            written = true;
+        }
+        if (auto n = queue.dropped.exchange (0, std::memory_order_relaxed))
+        {
+            queue.file << time_prefix (std::time (nullptr)) << level_prefix (log_level::warning)
+                       << n << " log records dropped, too many at once." << std::endl;
+            written = true;
+        }
+        if (written)
+        {
+            queue.file.flush ();
+            queue.flushed.store (queue.records.popped (), std::memory_order_release);
+            continue;
+        }
+
+        // Looked at again once asleep, as a record handed over meanwhile may not have seen it so.
+        // Pairs with the fence in wake_writer ().
+        queue.sleeping.store (true, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+        if (queue.records.pushed () != queue.records.popped ()
+                || queue.dropped.load (std::memory_order_relaxed))
+        {
+            queue.sleeping.store (false, std::memory_order_relaxed);
+            std::this_thread::yield ();     // The record may be still being pushed
+            continue;
+        }
+        queue.sleeping.wait (true);
+    }
+}
+
+/// After a record is handed over or dropped, only a flag is checked unless the writer sleeps
+
+static void
+wake_writer ()
+{
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+    if (queue.sleeping.load (std::memory_order_relaxed) && queue.sleeping.exchange (false))
+        queue.sleeping.notify_one ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// What a thread formats a record into, handed over at each flush
+
+class record_buffer : public std::streambuf
+{
+public:
+    /// Any text left without a flush goes first, as its own record
+    void begin (log_level level)
+    {
+        publish ();
+        record.level = level;
+    }
+
+protected:
+    int_type overflow (int_type c) override
+    {
+        if (!traits_type::eq_int_type (c, traits_type::eof ()))
+            record.text += traits_type::to_char_type (c);
+        return traits_type::not_eof (c);
+    }
+
+    std::streamsize xsputn (const char* s, std::streamsize n) override
+    {
+        record.text.append (s, std::size_t (n));
+        return n;
+    }
+
+    int sync () override
+    {
+        publish ();
+        return 0;
+    }
+
+private:
+    void publish ()
+    {
+        if (record.text.empty ())
+            return;
+        record.time = std::time (nullptr);
+        auto level = record.level;
+        if (!queue.records.push (record))
+            queue.dropped.fetch_add (1, std::memory_order_relaxed);
+        wake_writer ();
+        record.text.clear ();
+        record.level = level;
+    }
+
+    log_record_t record { log_level::info, 0, {} };
+};
+
+//--------------------------------------------------------------------------------------------------
+
+void
+open_logfile (std::string const& path)
+{
+    if (queue.opened.load ())
+        return;
+    logfile_path = path;
+    queue.file.open (logfile_path);
+    if (!queue.file.is_open ())
+        return;
+    // Detached, as there is no orderly DLL shutdown to join it
+    std::thread (writer_loop).detach ();
+    queue.opened.store (true);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::ostream&
+log (log_level level)
+{
+    thread_local record_buffer buffer;
+    thread_local std::ostream stream (&buffer);
+    // No buffer, so it fails and skips any formatting
+    thread_local std::ostream nowhere (nullptr);
+
+    if (level < queue.threshold.load (std::memory_order_relaxed)
+            || !queue.opened.load (std::memory_order_acquire))
+        return nowhere;
+    buffer.begin (level);
+    return stream;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+flush_log ()
+{
+    if (!queue.opened.load ())
+        return;
+    auto pos = queue.records.pushed ();
+    while (queue.flushed.load (std::memory_order_acquire) < pos)
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+set_log_threshold (log_level level)
+{
+    queue.threshold.store (level, std::memory_order_relaxed);
+}
+
+log_level
+log_threshold ()
+{
+    return queue.threshold.load (std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,154 @@
+/**
+ * @file placeholders.cpp
+ * @brief Variables named in the page text, as {{Game time (fixed)}}, shown with their outputs
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The page text keeps the placeholders, only what is drawn while reading has them expanded. Once
+ * per frame each variable builds a key of its name, params and inputs (see variable_t::inputs),
+ * and only a key which differs from the last one makes the pages lay out again - the game time
+ * once per game minute, say. Its output is evaluated at most once for all its placeholders.
+ *
+ * A placeholder naming no variable stays as written, so a mistyped name is easy to spot.
+ */
+
+#include "sse-journal.hpp"
+
+//--------------------------------------------------------------------------------------------------
+
+/// Longer placeholders are not looked for, as no variable is named so
+constexpr std::size_t max_name = 128;
+
+static unsigned revision = 1;
+
+/// The game state tick of the last check, the same for the whole frame
+static unsigned checked_tick = 0;
+static std::size_t checked_variables = 0;
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+has_placeholders (std::string_view text)
+{
+    return text.find ("{{") != std::string_view::npos;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+unsigned
+placeholders_revision ()
+{
+    auto tick = game_state ().tick;
+    if (tick == checked_tick)
+        return revision;
+    checked_tick = tick;
+
+    // Reused, so nothing is allocated while the keys stay the same
+    static std::string key;
+    bool changed = journal.variables.size () != checked_variables;
+    checked_variables = journal.variables.size ();
+    for (auto& v: journal.variables)
+    {
+        key.clear ();
+        key.append (v.name.c_str (), v.name.size () + 1);
+        key.append (v.params.c_str (), v.params.size () + 1);
+        if (v.inputs)
+            v.inputs (&v, key);
+        if (key != v.key)
+        {
+            v.key = key;
+            v.stale = true;
+            changed = true;
+        }
+    }
+    if (changed)
+        ++revision;
+    return revision;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static variable_t*
+find_variable (std::string_view name)
+{
+    for (auto& v: journal.variables)
+        if (v.name == name)
+            return &v;
+    return nullptr;
+}
+
+void
+expand_placeholders (std::string& out, std::string_view text)
+{
+    placeholders_revision ();
+    out.clear ();
+
+    std::size_t start = 0;
+    for (auto open = text.find ("{{"); open != std::string_view::npos;
+            open = text.find ("{{", start))
+    {
+        auto close = text.substr (open + 2, max_name + 2).find ("}}");
+        auto v = close == std::string_view::npos ? nullptr
+               : find_variable (text.substr (open + 2, close));
+        if (!v)
+        {
+            // Any "{{" further in may still be one
+            out.append (text.substr (start, open + 1 - start));
+            start = open + 1;
+            continue;
+        }
+        out.append (text.substr (start, open - start));
+        if (v->stale)
+        {
+            v->apply (v);
+            v->stale = false;
+        }
+        out += v->output;
+        start = open + 2 + close + 2;
+    }
+    out.append (text.substr (start));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::size_t
+freeze_placeholders ()
+{
+    std::string expanded;
+    std::size_t frozen = 0;
+    for (std::size_t i = 0; i < journal.pages.size (); ++i)
+    {
+        auto content = page_content (i);
+        if (!has_placeholders (content))
+            continue;
+        expand_placeholders (expanded, content);
+        if (expanded == content)
+            continue;
+        touch_page (i).content = std::string_view (expanded);
+        page_edited (i);
+        ++frozen;
+    }
+    return frozen;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,287 @@
+/**
+ * @file platform.cpp
+ * @brief The few operating system calls the journal core needs
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The plugin runs on Windows only, the POSIX part is there so the core can be built, profiled and
+ * benchmarked natively elsewhere. File names are UTF-8 on both.
+ */
+
+#include "sse-journal.hpp"
+#include <gsl/gsl_util>
+
+#include <stdexcept>
+
+#if defined(SSEIMGUI_WINDOWS)
+#  include <utils/winutils.hpp>
+#  include <d3d11.h>
+#else
+#  include <cerrno>
+#  include <cstring>
+#  include <cstdio>
+#  include <dirent.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+#if defined(SSEIMGUI_WINDOWS)
+
+static std::wstring
+wide_name (std::string const& file)
+{
+    std::wstring w;
+    utf8_to_utf16 (file.c_str (), w);
+    return w;
+}
+
+static std::string
+last_error ()
+{
+    return format_utf8message (::GetLastError ());
+}
+
+#else
+
+static std::string
+last_error ()
+{
+    return std::strerror (errno);
+}
+
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+void
+replace_file (std::string const& source, std::string const& destination)
+{
+#if defined(SSEIMGUI_WINDOWS)
+    bool ok = ::MoveFileExW (wide_name (source).c_str (), wide_name (destination).c_str (),
+                MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    bool ok = !std::rename (source.c_str (), destination.c_str ());
+#endif
+    if (!ok)
+        throw std::runtime_error ("Unable to replace " + destination + ": " + last_error ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+remove_file (std::string const& file)
+{
+#if defined(SSEIMGUI_WINDOWS)
+    bool ok = ::DeleteFileW (wide_name (file).c_str ()) || ::GetLastError () == ERROR_FILE_NOT_FOUND;
+#else
+    bool ok = !::unlink (file.c_str ()) || errno == ENOENT;
+#endif
+    if (!ok)
+        throw std::runtime_error ("Unable to remove " + file + ": " + last_error ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+file_exists (std::string const& file)
+{
+#if defined(SSEIMGUI_WINDOWS)
+    DWORD attr = ::GetFileAttributesW (wide_name (file).c_str ());
+    return attr != INVALID_FILE_ATTRIBUTES && !(attr & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return !::stat (file.c_str (), &st) && S_ISREG (st.st_mode);
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#if defined(SSEIMGUI_WINDOWS)
+
+static std::uint64_t
+to_uint64 (DWORD high, DWORD low)
+{
+    return (std::uint64_t (high) << 32) | low;
+}
+
+#endif
+
+bool
+file_info (std::string const& file, file_info_t& info)
+{
+#if defined(SSEIMGUI_WINDOWS)
+    WIN32_FILE_ATTRIBUTE_DATA fa;
+    if (!::GetFileAttributesExW (wide_name (file).c_str (), GetFileExInfoStandard, &fa)
+            || (fa.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
+    info.size = to_uint64 (fa.nFileSizeHigh, fa.nFileSizeLow);
+    info.mtime = to_uint64 (fa.ftLastWriteTime.dwHighDateTime, fa.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat st;
+    if (::stat (file.c_str (), &st) || !S_ISREG (st.st_mode))
+        return false;
+    info.size = std::uint64_t (st.st_size);
+    info.mtime = std::uint64_t (st.st_mtim.tv_sec) * 1000000000u + st.st_mtim.tv_nsec;
+#endif
+    info.name = file;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::vector<file_info_t>
+list_files (std::string const& directory, std::string const& extension)
+{
+    std::vector<file_info_t> files;
+#if defined(SSEIMGUI_WINDOWS)
+    WIN32_FIND_DATAW fd;
+    auto h = ::FindFirstFileW (wide_name (directory + "*" + extension).c_str (), &fd);
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        if (::GetLastError () == ERROR_FILE_NOT_FOUND)
+            return files;
+        throw std::runtime_error ("Unable to list " + directory + ": " + last_error ());
+    }
+    auto close_find = gsl::finally ([h] { ::FindClose (h); });
+    do
+    {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        std::string name;
+        if (!utf16_to_utf8 (fd.cFileName, name))
+            continue;
+        // The wildcard matches the short names too, e.g. "*.jso" the "*.json" files
+        if (!name.ends_with (extension))
+            continue;
+        files.push_back (file_info_t { std::move (name),
+                to_uint64 (fd.nFileSizeHigh, fd.nFileSizeLow),
+                to_uint64 (fd.ftLastWriteTime.dwHighDateTime, fd.ftLastWriteTime.dwLowDateTime) });
+    }
+    while (::FindNextFileW (h, &fd));
+    if (::GetLastError () != ERROR_NO_MORE_FILES)
+        throw std::runtime_error ("Unable to list " + directory + ": " + last_error ());
+#else
+    auto dir = ::opendir (directory.c_str ());
+    if (!dir)
+    {
+        if (errno == ENOENT)
+            return files;
+        throw std::runtime_error ("Unable to list " + directory + ": " + last_error ());
+    }
+    auto close_dir = gsl::finally ([dir] { ::closedir (dir); });
+    while (auto entry = ::readdir (dir))
+    {
+        std::string name = entry->d_name;
+        file_info_t info;
+        if (name.ends_with (extension) && file_info (directory + name, info))
+        {
+            info.name = std::move (name);
+            files.push_back (std::move (info));
+        }
+    }
+#endif
+    return files;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The handles are closed right away, the view keeps the file open until unmapped
+
+const char*
+map_file (std::string const& file, std::size_t& size)
+{
+    auto fail = [&file] (std::string const& what)
+    {
+        throw std::runtime_error (file + ": " + what);
+    };
+
+#if defined(SSEIMGUI_WINDOWS)
+    HANDLE h = ::CreateFileW (wide_name (file).c_str (), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        fail (last_error ());
+    auto close_file = gsl::finally ([h] { ::CloseHandle (h); });
+
+    LARGE_INTEGER sz;
+    if (!::GetFileSizeEx (h, &sz))
+        fail (last_error ());
+    if (!sz.QuadPart)
+        fail ("Empty file.");
+    size = std::size_t (sz.QuadPart);
+
+    HANDLE mapping = ::CreateFileMappingW (h, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+        fail (last_error ());
+    auto close_mapping = gsl::finally ([mapping] { ::CloseHandle (mapping); });
+
+    auto view = ::MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+        fail (last_error ());
+#else
+    int fd = ::open (file.c_str (), O_RDONLY);
+    if (fd < 0)
+        fail (last_error ());
+    auto close_file = gsl::finally ([fd] { ::close (fd); });
+
+    struct stat st;
+    if (::fstat (fd, &st))
+        fail (last_error ());
+    if (!st.st_size)
+        fail ("Empty file.");
+    size = std::size_t (st.st_size);
+
+    auto view = ::mmap (nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)
+        fail (last_error ());
+#endif
+    return static_cast<const char*> (view);
+}
+
+void
+unmap_file (const char* view, std::size_t size)
+{
+#if defined(SSEIMGUI_WINDOWS)
+    (void) size;
+    ::UnmapViewOfFile (view);
+#else
+    ::munmap (const_cast<char*> (view), size);
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+release_texture (ID3D11ShaderResourceView* texture)
+{
+#if defined(SSEIMGUI_WINDOWS)
+    texture->Release ();
+#else
+    (void) texture; // Stand-ins only, nothing to release
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+
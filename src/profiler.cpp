@@ -0,0 +1,262 @@
+/**
+ * @file profiler.cpp
+ * @brief Per-frame timings of the rendering sections, for the profiler overlay
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each profile_scope adds its time to its section total of the frame, which goes into a ring of
+ * the last #ring_size frames when the next one starts. Only the render thread is timed, the
+ * workers have their own pace, and nothing is done unless enabled but checking a flag.
+ *
+ * A frame where a section did not run is left out of its statistics.
+ *
+ * The same scopes are the spans of the trace, see trace.cpp, on all threads.
+ */
+
+#include "sse-journal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+//--------------------------------------------------------------------------------------------------
+
+using profile_clock = std::chrono::steady_clock;
+
+/// Ten seconds at sixty frames per second
+constexpr std::size_t ring_size = 600;
+
+struct section_t
+{
+    const char* name;
+    double frame_ms;            ///< Total of the frame so far
+    bool ran;
+    std::vector<float> ring;    ///< Milliseconds per frame, NaN if it did not run
+};
+
+static std::vector<section_t> sections;
+
+/// Recorded so far, the ring position being this modulo ring_size
+static std::size_t frames = 0;
+
+/// Read by the scopes on all threads, only the render thread changes it
+static std::atomic<bool> enabled { false };
+/// Set by profile_frame (), so no thread reads what another one writes
+static thread_local bool render_thread = false;
+static profile_clock::time_point frame_start;
+
+//--------------------------------------------------------------------------------------------------
+
+/// The names are string literals, mostly found by their address
+
+static int
+section_index (const char* name)
+{
+    for (std::size_t i = 0; i < sections.size (); ++i)
+        if (sections[i].name == name || !std::strcmp (sections[i].name, name))
+            return int (i);
+    sections.push_back (section_t { name, 0, false,
+            std::vector<float> (ring_size, std::nanf ("")) });
+    return int (sections.size () - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+profile_scope::profile_scope (const char* section)
+    : name (section), section (-1), traced (tracing_enabled ()), count (0)
+{
+    if (render_thread && enabled.load (std::memory_order_relaxed))
+        this->section = section_index (section);
+    if (this->section >= 0 || traced)
+        start = profile_clock::now ().time_since_epoch ().count ();
+}
+
+profile_scope::~profile_scope ()
+{
+    if (section < 0 && !traced)
+        return;
+    auto now = profile_clock::now ().time_since_epoch ().count ();
+    if (traced)
+        trace_span (name, start, now, args.data (), count);
+    if (section < 0)
+        return;
+    auto& s = sections[section];
+    s.frame_ms += std::chrono::duration<double, std::milli> (
+            profile_clock::duration (now - start)).count ();
+    s.ran = true;
+}
+
+void
+profile_scope::arg (const char* name, std::uint64_t value)
+{
+    if (traced && count < args.size ())
+        args[count++] = trace_arg_t { name, value };
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+profile_frame ()
+{
+    auto now = profile_clock::now ();
+    render_thread = true;
+    if (!enabled.load (std::memory_order_relaxed))
+    {
+        frame_start = now;
+        return;
+    }
+
+    // The time between the frames starts, so what the whole game takes
+    auto frame = section_index ("frame");
+    sections[frame].frame_ms = std::chrono::duration<double, std::milli> (now - frame_start).count ();
+    sections[frame].ran = frame_start != profile_clock::time_point {};
+    frame_start = now;
+
+    auto slot = frames++ % ring_size;
+    for (auto& s: sections)
+    {
+        s.ring[slot] = s.ran ? float (s.frame_ms) : std::nanf ("");
+        s.frame_ms = 0;
+        s.ran = false;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+enable_profiler (bool on)
+{
+    if (on && !enabled.load (std::memory_order_relaxed))
+        frame_start = {};
+    enabled.store (on, std::memory_order_relaxed);
+}
+
+bool
+profiler_enabled ()
+{
+    return enabled.load (std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::vector<float>
+profile_history (const char* section)
+{
+    std::vector<float> history;
+    auto n = std::min (frames, ring_size);
+    for (auto const& s: sections)
+        if (!std::strcmp (s.name, section))
+            for (auto i = frames - n; i < frames; ++i)
+                history.push_back (s.ring[i % ring_size]);
+    return history;
+}
+
+std::vector<float>
+profile_histogram (const char* section, float bucket_ms, std::size_t buckets)
+{
+    // As floats, which is what ImGui plots
+    std::vector<float> counts (buckets, 0.f);
+    if (!buckets)
+        return counts;
+    for (auto ms: profile_history (section))
+        if (!std::isnan (ms))
+            counts[std::min (std::size_t (std::max (ms, 0.f) / bucket_ms), buckets - 1)] += 1;
+    return counts;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::vector<profile_stats_t>
+profile_stats ()
+{
+    std::vector<profile_stats_t> stats;
+    std::vector<float> ms;
+    for (auto const& s: sections)
+    {
+        ms.clear ();
+        std::copy_if (s.ring.begin (), s.ring.end (), std::back_inserter (ms),
+                [] (float v) { return !std::isnan (v); });
+        profile_stats_t st { s.name, ms.size (), 0, 0, 0, 0 };
+        if (!ms.empty ())
+        {
+            auto [lo, hi] = std::minmax_element (ms.begin (), ms.end ());
+            st.min = *lo;
+            st.max = *hi;
+            double sum = 0;
+            for (auto v: ms)
+                sum += v;
+            st.avg = float (sum / ms.size ());
+            auto p99 = ms.begin () + std::min (ms.size () - 1, ms.size () * 99 / 100);
+            std::nth_element (ms.begin (), p99, ms.end ());
+            st.p99 = *p99;
+        }
+        stats.push_back (st);
+    }
+    return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// One row per frame, oldest first, and a column per section: empty where it did not run
+
+bool
+dump_profile (std::string const& file)
+{
+    std::ofstream of (file);
+    if (!of.is_open ())
+    {
+        log (log_level::error) << "Unable to open " << file << " for writting." << std::endl;
+        return false;
+    }
+
+    of << "index";
+    for (auto const& s: sections)
+        of << ',' << s.name;
+    of << '\n';
+
+    auto n = std::min (frames, ring_size);
+    for (auto i = frames - n; i < frames; ++i)
+    {
+        of << i;
+        for (auto const& s: sections)
+        {
+            of << ',';
+            if (!std::isnan (s.ring[i % ring_size]))
+                of << s.ring[i % ring_size];
+        }
+        of << '\n';
+    }
+
+    of.close ();
+    if (!of)
+    {
+        log (log_level::error) << "Unable to write " << file << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
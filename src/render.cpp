@@ -26,10 +26,14 @@
  */
 
 #include "sse-journal.hpp"
+#include <utils/winutils.hpp>
 #include <cctype>
+#include <cfloat>
 #include <cstring>
 #include <gsl/gsl_util>
 
+#include <d3d11.h>
+
 //--------------------------------------------------------------------------------------------------
 
 auto constexpr lite_tint = IM_COL32(191, 157, 111, 64);
@@ -37,8 +41,6 @@ auto constexpr dark_tint = IM_COL32(191, 157, 111, 96);
 auto constexpr frame_col = IM_COL32(192, 157, 111, 192);
 using namespace std::string_literals;
 
-journal_t journal = {};
-
 //--------------------------------------------------------------------------------------------------
 
 ImVec2 button_t::wpos = {};
@@ -54,30 +56,34 @@ void button_t::init(const char *label, float tlx, float tly, float szx,
 }
 
 bool button_t::draw() {
-  imgui.igPushFont(journal.button_font.imfont);
-  imgui.igPushStyleColor_U32(ImGuiCol_Text, journal.button_font.color);
   ImVec2 ptl{wsz.x * tl.x, wsz.y * tl.y}, psz{wsz.x * sz.x, wsz.y * sz.y};
   imgui.igSetCursorPos(ptl);
   bool pressed = imgui.igInvisibleButton(label, psz, 0);
-  bool hovered = imgui.igIsItemHovered(0);
-  if (hovered) {
+  hover = imgui.igIsItemHovered(0);
+  return pressed;
+}
+
+void button_t::paint() const {
+  imgui.igPushFont(journal.button_font.imfont);
+  ImVec2 ptl{wpos.x + wsz.x * tl.x, wpos.y + wsz.y * tl.y};
+  ImVec2 psz{wsz.x * sz.x, wsz.y * sz.y};
+  auto draw_list = imgui.igGetWindowDrawList();
+  if (hover) {
     constexpr float vmax =
         .7226f; // The Background Y pixels reach ~72% of a 2k texture
     imgui.ImDrawList_AddImage(
-        imgui.igGetWindowDrawList(), journal.background,
-        ImVec2{wpos.x + ptl.x, wpos.y + ptl.y},
-        ImVec2{wpos.x + ptl.x + psz.x, wpos.y + ptl.y + psz.y},
-        ImVec2{tl.x, tl.y * vmax}, ImVec2{tl.x + sz.x, (tl.y + sz.y) * vmax},
-        hover_tint);
+        draw_list, journal.background, ptl,
+        ImVec2{ptl.x + psz.x, ptl.y + psz.y}, ImVec2{tl.x, tl.y * vmax},
+        ImVec2{tl.x + sz.x, (tl.y + sz.y) * vmax}, hover_tint);
   }
   ImVec2 txtsz;
   imgui.igCalcTextSize(&txtsz, label, label_end, false, -1.f);
-  imgui.igSetCursorPos(ImVec2{ptl.x + align.x * (psz.x - txtsz.x),
-                              ptl.y + align.y * (psz.y - txtsz.y)});
-  imgui.igTextUnformatted(label, label_end);
+  imgui.ImDrawList_AddText_FontPtr(
+      draw_list, imgui.igGetFont(), imgui.igGetFontSize(),
+      ImVec2{ptl.x + align.x * (psz.x - txtsz.x),
+             ptl.y + align.y * (psz.y - txtsz.y)},
+      journal.button_font.color, label, label_end, 0, nullptr);
   imgui.igPopFont();
-  imgui.igPopStyleColor(1);
-  return pressed;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -98,18 +104,20 @@ bool setup() {
 
   if (!sseimgui.ddsfile_texture(journal.background_file.c_str(), nullptr,
                                 &journal.background)) {
-    log() << "Unable to load DDS." << std::endl;
+    log(log_level::error) << "Unable to load DDS." << std::endl;
     return false;
   }
 
   auto &j = journal;
   j.button_prev.init("Prev##B", 0.f, 0, .050f, 1.f, lite_tint);
-  j.button_settings.init("Settings##B", .070f, 0, .128f, .060f, dark_tint, .5f,
+  j.button_settings.init("Settings##B", .070f, 0, .092f, .060f, dark_tint, .5f,
                          .85f);
-  j.button_elements.init("Elements##B", .212f, 0, .128f, .060f, dark_tint, .5f,
+  j.button_elements.init("Elements##B", .176f, 0, .092f, .060f, dark_tint, .5f,
                          .85f);
-  j.button_chapters.init("Chapters##B", .354f, 0, .128f, .060f, dark_tint, .5f,
+  j.button_chapters.init("Chapters##B", .282f, 0, .092f, .060f, dark_tint, .5f,
                          .85f);
+  j.button_search.init("Search##B", .388f, 0, .092f, .060f, dark_tint, .5f,
+                       .85f);
   j.button_save.init("Save##B", .528f, 0, .128f, .060f, dark_tint, .5f, .85f);
   j.button_saveas.init("Save As##B", .670f, 0, .128f, .060f, dark_tint, .5f,
                        .85f);
@@ -121,9 +129,7 @@ bool setup() {
   // each one. Should be bearable in practice for lower spec machines. The ImGui
   // is well responsive btw.
 
-  load_book(default_book); // This one also may not exist
-  if (journal.pages.size() < 3)
-    journal.pages.resize(2);
+  load_default_book(default_book); // This one also may not exist
   if (journal.current_page + 2 >= journal.pages.size())
     journal.current_page = 0;
 
@@ -142,13 +148,6 @@ static inline std::size_t next_pow2(std::size_t n) {
   return p;
 };
 
-static void append_input(std::string &text, std::string const &suffix) {
-  auto sz = std::strlen(text.c_str());
-  if (sz + suffix.size() > text.size())
-    text.resize(next_pow2(sz + suffix.size() + text.size()));
-  text.insert(sz, suffix);
-}
-
 static int imgui_text_resize(ImGuiInputTextCallbackData *data) {
   if (data->EventFlag == ImGuiInputTextFlags_CallbackResize) {
     auto str = reinterpret_cast<std::string *>(data->UserData);
@@ -175,6 +174,40 @@ bool imgui_input_multiline(const char *label, std::string &text,
       flags | ImGuiInputTextFlags_CallbackResize, imgui_text_resize, &text);
 }
 
+/// Page texts grow on their own and keep their length, which is picked up
+/// only when ImGui reports a change
+static int imgui_page_text_resize(ImGuiInputTextCallbackData *data) {
+  if (data->EventFlag == ImGuiInputTextFlags_CallbackResize) {
+    auto text = reinterpret_cast<page_text *>(data->UserData);
+    text->reserve(data->BufSize - 1);
+    data->Buf = text->data();
+    data->BufSize = int(text->capacity() + 1);
+  }
+  return 0;
+}
+
+static bool imgui_input_text(const char *label, page_text &text,
+                             ImGuiInputTextFlags flags = 0) {
+  if (!imgui.igInputText(label, text.data(), text.capacity() + 1,
+                         flags | ImGuiInputTextFlags_CallbackResize,
+                         imgui_page_text_resize, &text))
+    return false;
+  text.edited();
+  return true;
+}
+
+static bool imgui_input_multiline(const char *label, page_text &text,
+                                  ImVec2 const &size,
+                                  ImGuiInputTextFlags flags = 0) {
+  if (!imgui.igInputTextMultiline(label, text.data(), text.capacity() + 1,
+                                  size,
+                                  flags | ImGuiInputTextFlags_CallbackResize,
+                                  imgui_page_text_resize, &text))
+    return false;
+  text.edited();
+  return true;
+}
+
 //--------------------------------------------------------------------------------------------------
 
 static void popup_error(bool begin, const char *name) {
@@ -191,37 +224,14 @@ static void popup_error(bool begin, const char *name) {
 
 //--------------------------------------------------------------------------------------------------
 
+/// Mod commands run per frame, the rest wait for the next ones
+constexpr std::size_t commands_per_frame = 16;
+
 /// This must be called before the main window begin()
 
 static void journal_command() {
-  if (journal_message.empty())
-    return;
-  auto clear = gsl::finally([] { journal_message.clear(); });
-
-  auto pos = journal_message.find_last_of('@');
-  if (pos != std::string::npos) {
-    auto book = books_directory + journal_message.substr(pos + 1) + ".json";
-    if (!load_book(book)) {
-      log() << "Unable to load mod requested book " << book << std::endl;
-      return;
-    }
-    journal_message.erase(journal_message.begin() + pos);
-  }
-
-  auto it = std::find_if(
-      journal.pages.cbegin(), journal.pages.cend(), [](page_t const &p) {
-        return p.title.find(journal_message) != std::string::npos ||
-               p.content.find(journal_message) != std::string::npos;
-      });
-
-  if (it == journal.pages.cend()) {
-    log() << "Unable to find mod requested string " << journal_message
-          << std::endl;
+  if (!run_commands(commands_per_frame))
     return;
-  }
-
-  auto page = std::distance(journal.pages.cbegin(), it);
-  journal.current_page = std::min(std::size_t(page), journal.pages.size() - 2);
 
   if (journal.show_titlebar)
     imgui.igSetNextWindowCollapsed(false, 0);
@@ -231,13 +241,20 @@ static void journal_command() {
 //--------------------------------------------------------------------------------------------------
 
 void SSEIMGUI_CCONV render(int active) {
+  // Also while hidden, so the frame times stay those of the game
+  profile_frame();
+  tick_game_state();
   if (!active)
     return;
+  profile_scope render_scope("render");
 
   imgui.igSetNextWindowSize(ImVec2{800, 600}, ImGuiCond_FirstUseEver);
   imgui.igPushFont(journal.default_font.imfont);
 
-  journal_command();
+  {
+    profile_scope scope("journal_command");
+    journal_command();
+  }
 
   if (imgui.igBegin("SSE Journal", nullptr,
                     !journal.show_titlebar * (ImGuiWindowFlags_NoTitleBar |
@@ -245,26 +262,258 @@ void SSEIMGUI_CCONV render(int active) {
                         ImGuiWindowFlags_NoScrollbar |
                         ImGuiWindowFlags_NoBackground)) {
     extern void draw_book();
+    profile_scope scope("draw_book");
     draw_book();
   }
   imgui.igEnd();
   imgui.igPopFont();
 
   extern void draw_settings();
-  if (journal.show_settings)
+  if (journal.show_settings) {
+    profile_scope scope("draw_settings");
     draw_settings();
+  }
   extern void draw_elements();
-  if (journal.show_elements)
+  if (journal.show_elements) {
+    profile_scope scope("draw_elements");
     draw_elements();
+  }
   extern void draw_chapters();
-  if (journal.show_chapters)
+  if (journal.show_chapters) {
+    profile_scope scope("draw_chapters");
     draw_chapters();
+  }
+  extern void draw_search();
+  if (journal.show_search) {
+    profile_scope scope("draw_search");
+    draw_search();
+  }
   extern void draw_saveas();
-  if (journal.show_saveas)
+  if (journal.show_saveas) {
+    profile_scope scope("draw_saveas");
     draw_saveas();
+  }
   extern void draw_load();
-  if (journal.show_load)
+  if (journal.show_load) {
+    profile_scope scope("draw_load");
     draw_load();
+  }
+  extern void draw_profiler();
+  if (journal.show_profiler)
+    draw_profiler();
+  else
+    enable_profiler(false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Vertices put back from the caches and drawn anew, in the last and in the
+/// current frame
+static std::array<unsigned, 2> cached_vertices, drawn_vertices;
+
+/**
+ * What is drawn into the window draw list for a part of the journal which
+ * rarely changes, kept while its key stays the same and put back into the list
+ * instead of drawing it again.
+ *
+ * ImDrawList_CloneOutput() would copy the whole list, the part drawn before
+ * included, so the recording takes the appended vertices and indices itself,
+ * split at the texture and clip rectangle changes, as ImGui does.
+ */
+
+template <class Key> struct draw_cache_t {
+  struct segment_t {
+    ImVec4 clip;
+    ImTextureID texture;
+    unsigned vtx_offset, vtx_count, idx_offset, idx_count;
+  };
+  std::vector<segment_t> segments;
+  std::vector<ImDrawVert> vertices;
+  std::vector<ImDrawIdx> indices; ///< Relative to the first segment vertex
+  Key key;
+  bool valid = false;
+
+  template <class F> void draw(Key const &k, F &&paint) {
+    auto dl = imgui.igGetWindowDrawList();
+    if (valid && key == k) {
+      replay(dl);
+      cached_vertices[1] += unsigned(vertices.size());
+      return;
+    }
+    int idx_begin = dl->IdxBuffer.Size, vtx_begin = dl->VtxBuffer.Size;
+    paint();
+    record(dl, idx_begin);
+    drawn_vertices[1] += unsigned(dl->VtxBuffer.Size - vtx_begin);
+    key = k;
+  }
+
+  void record(ImDrawList *dl, int idx_begin) {
+    segments.clear();
+    vertices.clear();
+    indices.clear();
+    int idx_end = dl->IdxBuffer.Size;
+    for (int c = 0; c < dl->CmdBuffer.Size; ++c) {
+      auto const &cmd = dl->CmdBuffer.Data[c];
+      int b = std::max(int(cmd.IdxOffset), idx_begin);
+      int e = std::min(int(cmd.IdxOffset + cmd.ElemCount), idx_end);
+      if (b >= e)
+        continue;
+      // No callbacks are expected here, a part with one is not cached
+      if (cmd.UserCallback) {
+        valid = false;
+        return;
+      }
+      unsigned lo = ~0u, hi = 0;
+      for (int i = b; i < e; ++i) {
+        lo = std::min(lo, cmd.VtxOffset + dl->IdxBuffer.Data[i]);
+        hi = std::max(hi, cmd.VtxOffset + dl->IdxBuffer.Data[i]);
+      }
+      segments.push_back(segment_t{cmd.ClipRect, cmd.TextureId,
+                                   unsigned(vertices.size()), hi - lo + 1,
+                                   unsigned(indices.size()), unsigned(e - b)});
+      vertices.insert(vertices.end(), dl->VtxBuffer.Data + lo,
+                      dl->VtxBuffer.Data + hi + 1);
+      for (int i = b; i < e; ++i)
+        indices.push_back(
+            ImDrawIdx(cmd.VtxOffset + dl->IdxBuffer.Data[i] - lo));
+    }
+    valid = true;
+  }
+
+  void replay(ImDrawList *dl) const {
+    for (auto const &s : segments) {
+      imgui.ImDrawList_PushClipRect(dl, ImVec2{s.clip.x, s.clip.y},
+                                    ImVec2{s.clip.z, s.clip.w}, false);
+      imgui.ImDrawList_PushTextureID(dl, s.texture);
+      imgui.ImDrawList_PrimReserve(dl, int(s.idx_count), int(s.vtx_count));
+      std::copy_n(vertices.data() + s.vtx_offset, s.vtx_count,
+                  dl->_VtxWritePtr);
+      for (unsigned i = 0; i < s.idx_count; ++i)
+        dl->_IdxWritePtr[i] =
+            ImDrawIdx(dl->_VtxCurrentIdx + indices[s.idx_offset + i]);
+      dl->_VtxWritePtr += s.vtx_count;
+      dl->_IdxWritePtr += s.idx_count;
+      dl->_VtxCurrentIdx += s.vtx_count;
+      imgui.ImDrawList_PopTextureID(dl);
+      imgui.ImDrawList_PopClipRect(dl);
+    }
+  }
+};
+
+/// The background and the buttons look
+struct chrome_key_t {
+  std::array<float, 4> window; ///< Position and size
+  bool titlebar;               ///< Changes the clipping
+  ImTextureID background, glyphs;
+  ImFont *font;
+  float font_scale;
+  std::uint32_t font_color;
+  unsigned hovered; ///< A bit for each button
+  bool operator==(chrome_key_t const &) const = default;
+};
+
+/// The images of the two pages shown, with all they are drawn by
+struct images_key_t {
+  std::array<float, 4> window;
+  std::array<ID3D11ShaderResourceView *, 2> refs;
+  std::array<std::uint32_t, 2> tints;
+  std::array<std::array<float, 4>, 4> uv_xy;
+  bool operator==(images_key_t const &) const = default;
+};
+
+static draw_cache_t<chrome_key_t> chrome_cache;
+static draw_cache_t<images_key_t> images_cache;
+
+//--------------------------------------------------------------------------------------------------
+
+/// Read-only view of a page text, laid out again only when the book, font or
+/// size change, or the outputs of its placeholders
+struct page_view_t {
+  std::size_t page = std::size_t(-1);
+  unsigned revision = 0;
+  text_layout_t layout;
+  bool editing = false; ///< The InputText widget was active last frame
+  std::size_t scrolled_page = std::size_t(-1);
+  float scroll = 0; ///< Of the InputText widget, last shown with scrolled_page
+  bool placeholders = false;
+  unsigned placeholders_revision = 0;
+  std::string expanded; ///< What is shown, if it has placeholders
+};
+
+static std::array<page_view_t, 2> page_views;
+
+/// While the player is only reading, the page is drawn straight from its
+/// layout, the visible lines only, scrolled as the InputText widget was left.
+/// The widget takes over once hovered (so the click lands in it) and until it
+/// is left.
+
+static bool draw_page_content(page_view_t &view, const char *label,
+                              std::size_t page, ImVec2 pos, ImVec2 size) {
+  auto wpos = button_t::wpos;
+  ImVec2 min{wpos.x + pos.x, wpos.y + pos.y};
+  ImVec2 max{min.x + size.x, min.y + size.y};
+  auto &text = journal.pages[page].content;
+  auto draw_list = imgui.igGetWindowDrawList();
+
+  bool hovered = imgui.igIsWindowHovered(ImGuiHoveredFlags_ChildWindows) &&
+                 imgui.igIsMouseHoveringRect(min, max, true);
+  if (hovered || view.editing) {
+    imgui.igSetCursorPos(pos);
+    // Another page starts at its top, as the read-only view showed it
+    if (view.scrolled_page != page)
+      imgui.igSetNextWindowScroll(ImVec2{0, 0});
+    bool changed = imgui_input_multiline(label, text, size);
+    // The widget scrolls in its own child window, the last one begun in here
+    auto const &children = imgui.igGetCurrentWindow()->DC.ChildWindows;
+    if (children.Size) {
+      view.scroll = children.Data[children.Size - 1]->Scroll.y;
+      view.scrolled_page = page;
+    }
+    view.editing = imgui.igIsItemActive();
+    if (imgui.igIsItemHovered(0) && !view.editing)
+      imgui.ImDrawList_AddRect(draw_list, min, max, frame_col, 0,
+                               ImDrawFlags_RoundCornersAll, 2.f);
+    return changed;
+  }
+
+  auto font = imgui.igGetFont();
+  auto font_size = imgui.igGetFontSize();
+  auto pad = imgui.igGetStyle()->FramePadding;
+  float width = size.x - 2 * pad.x;
+  auto &layout = view.layout;
+  bool changed = view.page != page || view.revision != book_revision();
+  if (changed)
+    view.placeholders = has_placeholders(text.view());
+  if (view.placeholders &&
+      (changed || view.placeholders_revision != placeholders_revision())) {
+    expand_placeholders(view.expanded, text.view());
+    view.placeholders_revision = placeholders_revision();
+    changed = true;
+  }
+  auto shown =
+      view.placeholders ? std::string_view(view.expanded) : text.view();
+  if (changed || layout.font != font || layout.size != font_size ||
+      layout.width != width) {
+    layout_text(layout, shown, *font, font_size, width);
+    view.page = page;
+    view.revision = book_revision();
+  }
+
+  // Lines are as high as the font, alike to InputTextMultiline
+  float scroll = view.scrolled_page == page ? view.scroll : 0;
+  auto first = std::min(layout.starts.size(), std::size_t(scroll / font_size));
+  auto last = std::min(layout.starts.size(),
+                       std::size_t((scroll + size.y - pad.y) / font_size) + 1);
+  imgui.ImDrawList_PushClipRect(draw_list, min, max, true);
+  for (std::size_t i = first; i < last; ++i)
+    if (layout.ends[i] > layout.starts[i])
+      imgui.ImDrawList_AddText_FontPtr(
+          draw_list, font, font_size,
+          ImVec2{min.x + pad.x, min.y + pad.y + i * font_size - scroll},
+          journal.text_font.color, shown.data() + layout.starts[i],
+          shown.data() + layout.ends[i], 0, nullptr);
+  imgui.ImDrawList_PopClipRect(draw_list);
+  return false;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -277,10 +526,9 @@ void draw_book() {
   imgui.igGetWindowSize(&button_t::wsz);
   auto wpos = button_t::wpos;
   auto wsz = button_t::wsz;
-
-  imgui.ImDrawList_AddImage(imgui.igGetWindowDrawList(), journal.background,
-                            wpos, ImVec2{wpos.x + wsz.x, wpos.y + wsz.y},
-                            ImVec2{0, 0}, ImVec2{1, .7226f}, IM_COL32_WHITE);
+  std::array<float, 4> window{wpos.x, wpos.y, wsz.x, wsz.y};
+  cached_vertices = {cached_vertices[1], 0};
+  drawn_vertices = {drawn_vertices[1], 0};
 
   // Ratio, ratio multiplied by pixel size and the absolute positions summed
   // with these are used all below. It may be pulled off as more capsulated and
@@ -302,15 +550,21 @@ void draw_book() {
     journal.show_elements = !journal.show_elements;
   if (journal.button_chapters.draw())
     journal.show_chapters = !journal.show_chapters;
+  if (journal.button_search.draw())
+    journal.show_search = !journal.show_search;
   if (journal.button_saveas.draw())
     journal.show_saveas = !journal.show_saveas;
   if (journal.button_load.draw())
     journal.show_load = !journal.show_load;
 
-  bool action_ok = true;
-  if (journal.button_save.draw())
-    action_ok = save_book(default_book);
-  popup_error(!action_ok, "Saving book failed");
+  if (journal.button_save.draw()) {
+    if (journal.freeze_variables)
+      freeze_placeholders();
+    save_book_async(default_book);
+  }
+  ImVec2 save_min, save_max;
+  imgui.igGetItemRectMin(&save_min);
+  imgui.igGetItemRectMax(&save_max);
 
   extern void previous_page();
   if (journal.button_prev.draw())
@@ -319,12 +573,52 @@ void draw_book() {
   if (journal.button_next.draw())
     next_page();
 
+  // Only the input is handled above, the looks change only on hover and resize
+  std::array<button_t const *, 9> buttons{
+      &journal.button_settings, &journal.button_elements,
+      &journal.button_chapters, &journal.button_search,
+      &journal.button_saveas,   &journal.button_load,
+      &journal.button_save,     &journal.button_prev,
+      &journal.button_next};
+  auto font = journal.button_font.imfont;
+  chrome_key_t chrome{window,
+                      journal.show_titlebar,
+                      journal.background,
+                      font->ContainerAtlas->TexID,
+                      font,
+                      font->Scale,
+                      journal.button_font.color,
+                      0};
+  for (std::size_t i = 0; i < buttons.size(); ++i)
+    chrome.hovered |= unsigned(buttons[i]->hovered()) << i;
+  chrome_cache.draw(chrome, [&] {
+    imgui.ImDrawList_AddImage(imgui.igGetWindowDrawList(), journal.background,
+                              wpos, ImVec2{wpos.x + wsz.x, wpos.y + wsz.y},
+                              ImVec2{0, 0}, ImVec2{1, .7226f}, IM_COL32_WHITE);
+    for (auto b : buttons)
+      b->paint();
+  });
+
+  auto save_state = book_save_status();
+  if (save_state == save_status::saving)
+    imgui.ImDrawList_AddText_Vec2(imgui.igGetWindowDrawList(),
+                                  ImVec2{save_min.x, save_max.y},
+                                  journal.button_font.color, "Saving...",
+                                  nullptr);
+  popup_error(save_state == save_status::failed, "Saving book failed");
+
+  touch_page(journal.current_page);
+  touch_page(journal.current_page + 1);
+  prefetch_pages(journal.current_page);
+
   imgui.igPushFont(journal.chapter_font.imfont);
   imgui.igPushStyleColor_U32(ImGuiCol_Text, journal.chapter_font.color);
 
   imgui.igSetNextItemWidth(text_width);
   imgui.igSetCursorPos(ImVec2{left_page, title_top});
-  imgui_input_text("##Left title", journal.pages[journal.current_page].title);
+  if (imgui_input_text("##Left title",
+                       journal.pages[journal.current_page].title))
+    page_edited(journal.current_page);
   if (imgui.igIsItemHovered(0) && !imgui.igIsItemActive())
     imgui.ImDrawList_AddRect(
         imgui.igGetWindowDrawList(),
@@ -335,8 +629,9 @@ void draw_book() {
 
   imgui.igSetCursorPos(ImVec2{right_page, title_top});
   imgui.igSetNextItemWidth(text_width);
-  imgui_input_text("##Right title",
-                   journal.pages[journal.current_page + 1].title);
+  if (imgui_input_text("##Right title",
+                       journal.pages[journal.current_page + 1].title))
+    page_edited(journal.current_page + 1);
   if (imgui.igIsItemHovered(0) && !imgui.igIsItemActive())
     imgui.ImDrawList_AddRect(
         imgui.igGetWindowDrawList(),
@@ -357,52 +652,50 @@ void draw_book() {
   imgui.igPushStyleColor_U32(ImGuiCol_ScrollbarGrabActive,
                              IM_COL32_BLACK_TRANS);
 
+  // Both below the texts, they do not overlap the other page
   auto &left_image = journal.pages[journal.current_page].image;
-  if (left_image.ref) {
-    imgui.ImDrawList_AddImage(
-        imgui.igGetWindowDrawList(), left_image.ref,
-        ImVec2{wpos.x + left_page + text_width * left_image.xy[0],
-               wpos.y + text_top + text_height * left_image.xy[1]},
-        ImVec2{wpos.x + left_page + text_width * left_image.xy[2],
-               wpos.y + text_top + text_height * left_image.xy[3]},
-        ImVec2{left_image.uv[0], left_image.uv[1]},
-        ImVec2{left_image.uv[2], left_image.uv[3]}, left_image.tint);
-  }
+  auto &right_image = journal.pages[journal.current_page + 1].image;
+  images_key_t images{window,
+                      {left_image.ref, right_image.ref},
+                      {left_image.tint, right_image.tint},
+                      {left_image.uv, left_image.xy, right_image.uv,
+                       right_image.xy}};
+  images_cache.draw(images, [&] {
+    if (left_image.ref) {
+      imgui.ImDrawList_AddImage(
+          imgui.igGetWindowDrawList(), left_image.ref,
+          ImVec2{wpos.x + left_page + text_width * left_image.xy[0],
+                 wpos.y + text_top + text_height * left_image.xy[1]},
+          ImVec2{wpos.x + left_page + text_width * left_image.xy[2],
+                 wpos.y + text_top + text_height * left_image.xy[3]},
+          ImVec2{left_image.uv[0], left_image.uv[1]},
+          ImVec2{left_image.uv[2], left_image.uv[3]}, left_image.tint);
+    }
+    if (right_image.ref) {
+      imgui.ImDrawList_AddImage(
+          imgui.igGetWindowDrawList(), right_image.ref,
+          ImVec2{wpos.x + right_page + text_width * right_image.xy[0],
+                 wpos.y + text_top + text_height * right_image.xy[1]},
+          ImVec2{wpos.x + right_page + text_width * right_image.xy[2],
+                 wpos.y + text_top + text_height * right_image.xy[3]},
+          ImVec2{right_image.uv[0], right_image.uv[1]},
+          ImVec2{right_image.uv[2], right_image.uv[3]}, right_image.tint);
+    }
+  });
+
   if (!left_image.ref || left_image.background) {
-    imgui.igSetCursorPos(ImVec2{left_page, text_top});
-    imgui_input_multiline("##Left text",
-                          journal.pages[journal.current_page].content,
-                          ImVec2{text_width, text_height});
-    if (imgui.igIsItemHovered(0) && !imgui.igIsItemActive())
-      imgui.ImDrawList_AddRect(imgui.igGetWindowDrawList(),
-                               ImVec2{wpos.x + left_page, wpos.y + text_top},
-                               ImVec2{wpos.x + left_page + text_width,
-                                      wpos.y + text_top + text_height},
-                               frame_col, 0, ImDrawFlags_RoundCornersAll, 2.f);
+    if (draw_page_content(page_views[0], "##Left text", journal.current_page,
+                          ImVec2{left_page, text_top},
+                          ImVec2{text_width, text_height}))
+      page_edited(journal.current_page);
   }
 
-  auto &right_image = journal.pages[journal.current_page + 1].image;
-  if (right_image.ref) {
-    imgui.ImDrawList_AddImage(
-        imgui.igGetWindowDrawList(), right_image.ref,
-        ImVec2{wpos.x + right_page + text_width * right_image.xy[0],
-               wpos.y + text_top + text_height * right_image.xy[1]},
-        ImVec2{wpos.x + right_page + text_width * right_image.xy[2],
-               wpos.y + text_top + text_height * right_image.xy[3]},
-        ImVec2{right_image.uv[0], right_image.uv[1]},
-        ImVec2{right_image.uv[2], right_image.uv[3]}, right_image.tint);
-  }
   if (!right_image.ref || right_image.background) {
-    imgui.igSetCursorPos(ImVec2{right_page, text_top});
-    imgui_input_multiline("##Right text",
-                          journal.pages[journal.current_page + 1].content,
-                          ImVec2{text_width, text_height});
-    if (imgui.igIsItemHovered(0) && !imgui.igIsItemActive())
-      imgui.ImDrawList_AddRect(imgui.igGetWindowDrawList(),
-                               ImVec2{wpos.x + right_page, wpos.y + text_top},
-                               ImVec2{wpos.x + right_page + text_width,
-                                      wpos.y + text_top + text_height},
-                               frame_col, 0, ImDrawFlags_RoundCornersAll, 2.f);
+    if (draw_page_content(page_views[1], "##Right text",
+                          journal.current_page + 1,
+                          ImVec2{right_page, text_top},
+                          ImVec2{text_width, text_height}))
+      page_edited(journal.current_page + 1);
   }
 
   imgui.igPopFont();
@@ -413,8 +706,6 @@ void draw_book() {
 
 //--------------------------------------------------------------------------------------------------
 
-static std::string greedy_word_wrap(std::string const &source, unsigned width);
-
 void
 draw_settings ()
 {
@@ -453,12 +744,25 @@ draw_settings ()
         imgui.igDragInt ("Line width", &wrap_width, 1, 40, 160, "%d", 0);
         if (imgui.igButton ("Wrap", ImVec2 {}))
         {
-            for (auto& p: journal.pages)
+            for (std::size_t i = 0; i < journal.pages.size (); ++i)
+            {
+                auto& p = touch_page (i);
                 p.content = greedy_word_wrap (p.content, wrap_width);
+                page_edited (i);
+            }
         }
 
         imgui.igDummy (ImVec2 { 1, imgui.igGetFrameHeight () });
         imgui.igCheckbox ("Show titlebar (allows show & hide)", &journal.show_titlebar);
+        imgui.igCheckbox ("Save only the changes (faster for big books)", &journal.edit_log);
+        imgui.igCheckbox ("Save {{variables}} in pages as their current outputs",
+                &journal.freeze_variables);
+        int level = int (log_threshold ());
+        if (imgui.igCombo_Str ("Log level", &level, "Debug\0Info\0Warning\0Error\0", -1))
+            set_log_threshold (log_level (level));
+        imgui.igTextDisabled ("Journal vertices last frame: %u cached, %u drawn anew",
+                cached_vertices[0], drawn_vertices[0]);
+        imgui.igCheckbox ("Show profiler (render times per frame)", &journal.show_profiler);
         imgui.igDummy (ImVec2 { 1, imgui.igGetFrameHeight () });
 
         bool save_ok = true;
@@ -479,6 +783,75 @@ draw_settings ()
 
 //--------------------------------------------------------------------------------------------------
 
+void
+draw_profiler ()
+{
+    enable_profiler (true);
+    imgui.igPushFont (journal.default_font.imfont);
+    if (imgui.igBegin ("SSE Journal: Profiler", &journal.show_profiler, 0))
+    {
+        // Not timing the drawing of the timings themselves
+        auto stats = profile_stats ();
+        constexpr int tflags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg
+            | ImGuiTableFlags_SizingFixedFit;
+        if (imgui.igBeginTable ("Sections", 6, tflags, ImVec2 {}, 0))
+        {
+            for (auto header: { "Section", "Frames", "Min ms", "Avg ms", "P99 ms", "Max ms" })
+                imgui.igTableSetupColumn (header, 0, 0, 0);
+            imgui.igTableHeadersRow ();
+            for (auto const& s: stats)
+            {
+                imgui.igTableNextRow (0, 0);
+                imgui.igTableNextColumn ();
+                imgui.igTextUnformatted (s.section, nullptr);
+                imgui.igTableNextColumn ();
+                imgui.igText ("%u", unsigned (s.frames));
+                for (auto ms: { s.min, s.avg, s.p99, s.max })
+                {
+                    imgui.igTableNextColumn ();
+                    imgui.igText ("%.3f", ms);
+                }
+            }
+            imgui.igEndTable ();
+        }
+
+        // The whole frame, what the game takes between two render calls
+        constexpr float bucket_ms = 1;
+        constexpr std::size_t buckets = 50;
+        auto histogram = profile_histogram ("frame", bucket_ms, buckets);
+        imgui.igTextUnformatted ("Frame time histogram: frames per 1 ms, from 0 to 50+ ms",
+                nullptr);
+        imgui.igPlotHistogram_FloatPtr ("##frame", histogram.data (), int (histogram.size ()), 0,
+                "frames by frame time", 0, FLT_MAX, ImVec2 { -1, 5 * imgui.igGetFrameHeight () },
+                sizeof (float));
+
+        bool dump_ok = true;
+        if (imgui.igButton ("Dump to profile.csv", ImVec2 {}))
+            dump_ok = dump_profile (journal_directory + "profile.csv");
+        popup_error (!dump_ok, "Dumping profile failed");
+
+        // Going to bug reports, hence next to the log
+        imgui.igDummy (ImVec2 { 1, imgui.igGetFrameHeight () });
+        bool tracing = tracing_enabled ();
+        if (imgui.igCheckbox ("Record trace (all threads, restarts when checked)", &tracing))
+            enable_tracing (tracing);
+        imgui.igSameLine (0, -1);
+        imgui.igTextDisabled ("%u spans", unsigned (traced_events ()));
+
+        bool trace_ok = true;
+        if (imgui.igButton ("Write sse-journal-trace.json", ImVec2 {}))
+        {
+            auto dir = logfile_path.substr (0, logfile_path.find_last_of ("\\/") + 1);
+            trace_ok = write_trace (dir + "sse-journal-trace.json");
+        }
+        popup_error (!trace_ok, "Writing trace failed");
+    }
+    imgui.igEnd ();
+    imgui.igPopFont ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
 static bool
 extract_variable_text (void* data, int idx, const char** out_text)
 {
@@ -504,13 +877,19 @@ draw_variables ()
     imgui.igBeginGroup ();
 
     if (imgui.igButton ("Append left", ImVec2 {}))
-        append_input (journal.pages[journal.current_page].content, output);
+    {
+        touch_page (journal.current_page).content += output;
+        page_edited (journal.current_page);
+    }
     imgui.igSameLine (0, -1);
     if (imgui.igButton ("Copy to Clipboard", ImVec2 {}))
         imgui.igSetClipboardText (output.c_str ());
     imgui.igSameLine (0, -1);
     if (imgui.igButton ("Append right", ImVec2 {}))
-        append_input (journal.pages[journal.current_page+1].content, output);
+    {
+        touch_page (journal.current_page+1).content += output;
+        page_edited (journal.current_page+1);
+    }
 
     if (imgui_input_text ("##Params", params, params_flags))
     {
@@ -547,6 +926,10 @@ draw_variables ()
             std::swap (journal.variables[varsel], journal.variables[varsel+1]);
             ++varsel;
         }
+    // Shown in the page with the variable output, once pasted into its text
+    if (imgui.igButton ("Copy placeholder", ImVec2 {-1, 0}))
+        if (varsel >= 0)
+            imgui.igSetClipboardText (("{{" + journal.variables[varsel].name + "}}").c_str ());
     if (imgui.igButton ("Copy as new", ImVec2 {-1, 0}))
         if (varsel >= 0)
         {
@@ -657,51 +1040,6 @@ extract_vector_string (void* data, int idx, const char** out_text)
 
 //--------------------------------------------------------------------------------------------------
 
-static void
-release_image (image_t& img)
-{
-    auto it = journal.images.find (img.ref);
-    if (it == journal.images.end ())
-        return;
-    if (--it->second.refcount == 0)
-    {
-        it->first->Release ();
-        journal.images.erase (it);
-    }
-    img.ref = nullptr;
-}
-
-//--------------------------------------------------------------------------------------------------
-
-bool
-obtain_image (std::string const& file, image_t& img)
-{
-    auto it = std::find_if (journal.images.begin (), journal.images.end (),
-            [&file] (auto const& kv) { return kv.second.file == file; });
-
-    if (it == journal.images.end ())
-    {
-        ID3D11ShaderResourceView* ref = nullptr;
-        if (!sseimgui.ddsfile_texture (file.c_str (), nullptr, &ref))
-            return false;
-        it = journal.images.emplace (ref, journal_t::image_source_t { 1, std::move (file) }).first;
-    }
-    else if (img.ref == it->first)
-    {
-        return true; // Happens if clicking buttons
-    }
-    else
-    {
-        release_image (img); //if any
-    }
-
-    img.ref = it->first;
-    ++it->second.refcount;
-    return true;
-}
-
-//--------------------------------------------------------------------------------------------------
-
 static void
 imgui_range_widget (const char* label, float& l, float& r)
 {
@@ -734,8 +1072,9 @@ draw_images ()
         | ImGuiColorEditFlags_DisplayHSV | ImGuiColorEditFlags_InputRGB
         | ImGuiColorEditFlags_PickerHueBar;
 
-    auto& left_image = journal.pages[journal.current_page].image;
-    auto& right_image = journal.pages[journal.current_page+1].image;
+    // Also while the journal is collapsed, when its pages may not be loaded yet
+    auto& left_image = touch_page (journal.current_page).image;
+    auto& right_image = touch_page (journal.current_page+1).image;
 
     ImVec2 cregavail;
     imgui.igGetContentRegionAvail (&cregavail);
@@ -819,45 +1158,47 @@ draw_elements ()
 
 //--------------------------------------------------------------------------------------------------
 
-static bool
-visible_symbols (std::string const& s)
-{
-    if (!s.empty ()) for (auto p = s.c_str (); *p; ++p)
-        if (*p != ' ' && !std::iscntrl (*p))
-            return true;
-    return false;
-}
-
-//--------------------------------------------------------------------------------------------------
-
-static bool
-extract_chapter_title (void* data, int idx, const char** out_text)
-{
-    auto const& title = journal.pages[idx].title;
-    if (visible_symbols (title))
-        *out_text = title.c_str ();
-    else
-        *out_text = "(n/a)";
-    return true;
-}
-
 void
 draw_chapters ()
 {
     static float items = 7.25f;
     static int selection = -1;
+    static std::string prefix;
 
     imgui.igPushFont (journal.default_font.imfont);
     if (imgui.igBegin ("SSE Journal: Chapters", &journal.show_chapters, 0))
     {
-        if (imgui.igListBox_FnBoolPtr ("##Chapters", &selection, extract_chapter_title, nullptr,
-                int (journal.pages.size ()), items))
+        imgui.igBeginGroup ();
+        imgui_input_text ("Filter##Chapters", prefix);
+        auto const& chapters = chapter_list (prefix.c_str ());
+
+        // Only the visible rows are touched, however many the pages
+        auto height = items * imgui.igGetTextLineHeightWithSpacing ();
+        if (imgui.igBeginListBox ("##Chapters", ImVec2 {0, height}))
         {
-            int ndx = selection;
-            if (ndx + 1 == int (journal.pages.size ()))
-                ndx--;
-            journal.current_page = ndx;
+            auto clipper = imgui.ImGuiListClipper_ImGuiListClipper ();
+            imgui.ImGuiListClipper_Begin (clipper, int (chapters.size ()), -1);
+            while (imgui.ImGuiListClipper_Step (clipper))
+                for (int i = clipper->DisplayStart; i < clipper->DisplayEnd; ++i)
+                {
+                    auto const& row = chapters[i];
+                    auto title = row.blank ? "(n/a)" : journal.pages[row.page].title.c_str ();
+                    imgui.igPushID_Int (int (row.page));
+                    if (imgui.igSelectable_Bool (title, int (row.page) == selection, 0, ImVec2 {}))
+                    {
+                        selection = int (row.page);
+                        int ndx = selection;
+                        if (ndx + 1 == int (journal.pages.size ()))
+                            ndx--;
+                        journal.current_page = ndx;
+                    }
+                    imgui.igPopID ();
+                }
+            imgui.ImGuiListClipper_End (clipper);
+            imgui.ImGuiListClipper_destroy (clipper);
+            imgui.igEndListBox ();
         }
+        imgui.igEndGroup ();
 
         imgui.igSameLine (0, -1);
         imgui.igBeginGroup ();
@@ -867,13 +1208,13 @@ draw_chapters ()
         {
             if (selection >= 0 && selection < int (journal.pages.size ()))
                 adjust = true,
-                journal.pages.insert (journal.pages.begin () + selection, page_t {});
+                insert_page (selection);
         }
         if (imgui.igButton ("Insert after", ImVec2 {-1, 0}))
         {
             if (selection >= 0 && selection < int (journal.pages.size ()))
                 adjust = true,
-                journal.pages.insert (journal.pages.begin () + selection + 1, page_t {});
+                insert_page (selection + 1);
         }
         if (imgui.igButton ("Delete", ImVec2 {-1, 0}))
             if (selection >= 0 && selection < int (journal.pages.size ()))
@@ -883,7 +1224,7 @@ draw_chapters ()
             if (imgui.igButton ("Are you sure?##Chapter", ImVec2 {}))
             {
                 adjust = true;
-                journal.pages.erase (journal.pages.begin () + selection);
+                erase_page (selection);
                 imgui.igCloseCurrentPopup ();
             }
             imgui.igEndPopup ();
@@ -892,13 +1233,13 @@ draw_chapters ()
 
         if (adjust)
         {
-            if (journal.pages.size () < 2)
-                journal.pages.resize (2);
+            while (journal.pages.size () < 2)
+                insert_page (journal.pages.size ());
             while (journal.current_page+2 > journal.pages.size ())
                 journal.current_page--;
         }
 
-        items = (imgui.igGetWindowHeight () / imgui.igGetTextLineHeightWithSpacing ()) - 2;
+        items = (imgui.igGetWindowHeight () / imgui.igGetTextLineHeightWithSpacing ()) - 3;
     }
     imgui.igEnd ();
     imgui.igPopFont ();
@@ -911,7 +1252,9 @@ draw_saveas ()
 {
     static std::string name;
     static int typesel = 0;
-    static std::array<const char*, 2> types = { "Journal book (*.json)", "Plain text (*.txt)" };
+    static std::array<const char*, 6> types = {
+        "Journal book (*.json)", "Compact journal book (*.json)", "Binary journal book (*.jbook)",
+        "CBOR journal book (*.cbor)", "MessagePack journal book (*.msgpack)", "Plain text (*.txt)" };
 
     imgui.igPushFont (journal.default_font.imfont);
     if (imgui.igBegin ("SSE Journal: Save as file", &journal.show_saveas, 0))
@@ -926,8 +1269,14 @@ draw_saveas ()
         {
             bool ok = true;
             auto root = books_directory + name.c_str ();
+            if (journal.freeze_variables)
+                freeze_placeholders ();
             if (typesel == 0) ok = save_book (root + ".json");
-            if (typesel == 1) ok = save_text (root + ".txt");
+            if (typesel == 1) ok = save_book (root + ".json", json_writer::style::compact);
+            if (typesel == 2) ok = save_book (root + ".jbook");
+            if (typesel == 3) ok = save_book (root + ".cbor");
+            if (typesel == 4) ok = save_book (root + ".msgpack");
+            if (typesel == 5) ok = save_text (root + ".txt");
             popup_error (!ok, "Save As failed");
             if (ok) journal.show_saveas = false;
         }
@@ -943,16 +1292,24 @@ draw_load ()
 {
     static int typesel = 0;
     static int namesel = -1;
-    static std::array<const char*, 2> types = { "Journal book (*.json)", "Take Notes (*.xml)" };
-    static std::array<const char*, 2> filters = { "*.json", "*.xml" };
+    static std::array<const char*, 5> types = {
+        "Journal book (*.json)", "Binary journal book (*.jbook)", "CBOR journal book (*.cbor)",
+        "MessagePack journal book (*.msgpack)", "Take Notes (*.xml)" };
+    static std::array<const char*, 5> filters = {
+        "*.json", "*.jbook", "*.cbor", "*.msgpack", "*.xml" };
     static std::vector<std::string> names;
     static bool reload_names = false;
     static float items = -1;
+    static std::string query;
+    static std::vector<library_hit_t> hits;
+    static bool indexing = false;
 
     if (journal.show_load != reload_names)
     {
         reload_names = journal.show_load;
         enumerate_filenames (books_directory + filters[typesel], names);
+        if (journal.show_load)
+            refresh_library_async ();
     }
 
     imgui.igPushFont (journal.default_font.imfont);
@@ -972,14 +1329,108 @@ draw_load ()
             bool ok = true;
             auto target = books_directory + names[namesel];
             if (typesel == 0) ok = load_book (target + ".json");
-            if (typesel == 1) ok = load_takenotes (target + ".xml");
+            if (typesel == 1) ok = load_book (target + ".jbook");
+            if (typesel == 2) ok = load_book (target + ".cbor");
+            if (typesel == 3) ok = load_book (target + ".msgpack");
+            if (typesel == 4) ok = load_takenotes (target + ".xml");
             popup_error (!ok, "Load book failed");
             if (ok) journal.show_load = false;
         }
         if (imgui.igButton ("Cancel", ImVec2 {-1, 0}))
             journal.show_load = false;
         imgui.igEndGroup ();
-        items = (imgui.igGetWindowHeight () / imgui.igGetTextLineHeightWithSpacing ()) - 4;
+
+        // Searched again also when a refresh ends, as the books may have changed
+        bool was_indexing = indexing;
+        indexing = library_busy ();
+        imgui.igSetNextItemWidth (-1);
+        if (imgui_input_text ("##Library", query) || (was_indexing && !indexing))
+            hits = library_search (query.c_str ());
+        if (indexing)
+            imgui.igTextDisabled ("Indexing books...");
+        else if (*query.c_str () && hits.empty ())
+            imgui.igTextDisabled ("Nothing found in %d books", int (library_books ()));
+        else
+            imgui.igTextDisabled ("Search all %d books", int (library_books ()));
+
+        imgui.igBeginChild_Str ("##Library hits", ImVec2 {}, false, 0);
+        for (std::size_t i = 0; i < hits.size (); ++i)
+        {
+            auto const& hit = hits[i];
+            auto label = hit.file + " - p. " + std::to_string (hit.page + 1) + ": " + hit.title;
+            imgui.igPushID_Int (int (i));
+            if (imgui.igSelectable_Bool (label.c_str (), false, 0, ImVec2 {}))
+            {
+                auto target = books_directory + hit.file;
+                bool ok = hit.file.ends_with (".xml") ? load_takenotes (target) : load_book (target);
+                popup_error (!ok, "Load book failed");
+                if (ok)
+                {
+                    // The book may have changed since it was indexed
+                    journal.current_page = unsigned (std::min (hit.page, journal.pages.size () - 2));
+                    journal.show_load = false;
+                }
+            }
+            imgui.igPopID ();
+        }
+        imgui.igEndChild ();
+        // The upper half, the library search takes the rest
+        items = (imgui.igGetWindowHeight () / imgui.igGetTextLineHeightWithSpacing ()) / 2 - 2;
+    }
+    imgui.igEnd ();
+    imgui.igPopFont ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+draw_search ()
+{
+    static std::string query;
+    static std::vector<search_hit_t> hits;
+    static bool searching = false;
+
+    imgui.igPushFont (journal.default_font.imfont);
+    if (imgui.igBegin ("SSE Journal: Search", &journal.show_search, 0))
+    {
+        if (imgui.igIsWindowAppearing ())
+            imgui.igSetKeyboardFocusHere (0);
+        imgui.igSetNextItemWidth (-1);
+        if (imgui_input_text ("##Query", query))
+        {
+            // The input buffer is padded
+            std::string text = query.c_str ();
+            searching = text.find_first_not_of (" \t") != std::string::npos;
+            if (searching)
+                search_async (text);
+            else
+                hits.clear ();
+        }
+        // Each frame until the worker is done, a newer query hides the results of the older
+        if (searching && take_search_results (hits))
+            searching = false;
+
+        if (searching)
+            imgui.igTextDisabled ("Searching...");
+        else if (*query.c_str () && hits.empty ())
+            imgui.igTextDisabled ("Nothing found");
+        else
+            imgui.igTextDisabled ("%d best matches", int (hits.size ()));
+
+        imgui.igBeginChild_Str ("##Hits", ImVec2 {}, false, ImGuiWindowFlags_HorizontalScrollbar);
+        for (std::size_t i = 0; i < hits.size (); ++i)
+        {
+            auto const& hit = hits[i];
+            auto label = "p. " + std::to_string (hit.page + 1);
+            imgui.igPushID_Int (int (i));
+            if (imgui.igSelectable_Bool (label.c_str (), false, 0, ImVec2 {}))
+                // The book may have changed since
+                journal.current_page = unsigned (std::min (hit.page, journal.pages.size () - 2));
+            imgui.igSameLine (0, -1);
+            imgui.igTextUnformatted (hit.snippet.c_str (), nullptr);
+            imgui.igPopID ();
+        }
+        imgui.igEndChild ();
     }
     imgui.igEnd ();
     imgui.igPopFont ();
@@ -1008,10 +1459,10 @@ next_page ()
     // not cautious.
     else if (journal.current_page + 2 == journal.pages.size ())
     {
-        if (visible_symbols (journal.pages.back ().title)
-                || visible_symbols (journal.pages.back ().content))
+        auto const& last = touch_page (journal.pages.size () - 1);
+        if (visible_symbols (last.title) || visible_symbols (last.content))
         {
-            journal.pages.push_back (page_t {});
+            insert_page (journal.pages.size ());
             journal.current_page++;
         }
     }
@@ -1019,37 +1470,3 @@ next_page ()
 
 //--------------------------------------------------------------------------------------------------
 
-static std::string
-greedy_word_wrap (std::string const& source, unsigned width)
-{
-    auto n = std::strlen (source.c_str ());
-    std::string out (n, 0);
-
-    for (unsigned i = 0; i < n; )
-    {
-        // copy string until the end of the line is reached
-        for (unsigned c = 1; c <= width; ++c, ++i)
-        {
-            if (i == n)
-                return out;
-            out[i] = source[i];
-            if (source[i] == '\n')
-                c = 1;
-        }
-
-        if (std::isspace (source[i]))
-            out[i++] = '\n';
-        // check for nearest whitespace back in string
-        else for (unsigned k = i; k > 0; --k)
-            if (std::isspace (source[k]))
-            {
-                out[k] = '\n';
-                i = k + 1;
-                break;
-            }
-    }
-    return out;
-}
-
-//--------------------------------------------------------------------------------------------------
-
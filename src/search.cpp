@@ -0,0 +1,639 @@
+/**
+ * @file search.cpp
+ * @brief Trigram index over the pages, for finding text in the book
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each three byte sequence found in a page title or content lists the pages having it, with the
+ * ASCII letters in lower case. A search intersects the lists of the trigrams in the searched text,
+ * and only the pages left are searched for real, in the page order, so the first match is the
+ * same one a scan over the book finds.
+ *
+ * The lists may name more pages than they should: edited pages are only added to, and erased pages
+ * are left in. Pages are listed by an id which does not change when pages are inserted or erased
+ * before them.
+ *
+ * The index is built on the search worker, from a snapshot of the book, as soon as the book is
+ * loaded or replaced, so no frame waits for it. The snapshot shares the page texts rather than
+ * copying them, a page is copied only if edited before the worker is done with it. Each change of
+ * the pages is stamped, and until the worker has indexed a change its page is searched for real.
+ * Edited pages are indexed again by the next search, in the background too.
+ *
+ * The Search window queries run on the same worker, over the snapshot of the book they are handed
+ * with: the worker first indexes its changed pages, then picks the candidates and ranks them by
+ * the number of matches. Each new query abandons the one still running.
+ */
+
+#include "sse-journal.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+//--------------------------------------------------------------------------------------------------
+
+using trigram_t = std::uint32_t;
+
+/// Sorted page ids by trigram
+using postings_t = std::unordered_map<trigram_t, std::vector<std::uint32_t>>;
+
+struct indexed_page_t
+{
+    std::uint32_t id;
+    std::uint64_t stamp;    ///< Of its last change, it is in the index if not newer than the index
+};
+
+/// In the order of journal.pages, kept by the render thread
+static std::vector<indexed_page_t> indexed;
+
+static std::uint32_t next_id = 0;
+/// Change stamps given out, and the one all pages got when the index was last dropped
+static std::uint64_t stamps = 0, rebuilt = 0;
+/// Of the last snapshot handed to the worker
+static std::uint64_t posted = 0;
+
+/// Owned by the worker, which changes it under the lock
+struct trigram_index_t
+{
+    std::mutex lock;
+    postings_t postings;
+    std::atomic<std::uint64_t> stamp;   ///< The pages changed up to it are in
+};
+
+/// Never destroyed, as the detached worker may still use it at exit
+static trigram_index_t& trigrams = *new trigram_index_t {};
+
+/// Set by release_book_snapshots (), the worker then drops its job at the next page
+static std::atomic<bool> cancelled = false;
+
+/// One bit per possible trigram, all clear between the uses, only for the worker
+static std::vector<std::uint64_t> seen;
+
+//--------------------------------------------------------------------------------------------------
+
+static inline std::uint8_t
+fold (char c)
+{
+    return c >= 'A' && c <= 'Z' ? std::uint8_t (c - 'A' + 'a') : std::uint8_t (c);
+}
+
+static inline trigram_t
+trigram_at (std::string_view text, std::size_t i)
+{
+    return trigram_t (fold (text[i-2])) << 16
+         | trigram_t (fold (text[i-1])) << 8
+         | trigram_t (fold (text[i]));
+}
+
+static void
+collect_trigrams (std::string_view text, std::vector<trigram_t>& out)
+{
+    for (std::size_t i = 2; i < text.size (); ++i)
+    {
+        auto t = trigram_at (text, i);
+        auto& word = seen[t >> 6];
+        auto bit = std::uint64_t (1) << (t & 63);
+        if (!(word & bit))
+        {
+            word |= bit;
+            out.push_back (t);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+index_page (postings_t& postings, std::uint32_t id, page_snapshot_t const& page)
+{
+    static std::vector<trigram_t> found;
+    found.clear ();
+    collect_trigrams (page.title.view, found);
+    collect_trigrams (page.content.view, found);
+
+    for (auto t: found)
+    {
+        seen[t >> 6] = 0;
+        auto& ids = postings[t];
+        // The ids only increase while building, keeps it linear
+        if (ids.empty () || ids.back () < id)
+            ids.push_back (id);
+        else
+        {
+            auto it = std::lower_bound (ids.begin (), ids.end (), id);
+            if (it == ids.end () || *it != id)
+                ids.insert (it, id);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// What the worker is to index: the snapshot pages with their ids, and which of them changed
+
+struct index_job_t
+{
+    std::shared_ptr<const book_snapshot_t> book;
+    std::vector<std::uint32_t> ids;
+    std::vector<std::size_t> changed;
+    std::uint64_t rebuilt, stamp;
+};
+
+/// On the worker, the index is built again if it is older than the last drop. False if cancelled,
+/// the pages of the job then count as not indexed.
+
+static bool
+update_index (index_job_t const& job)
+{
+    if (seen.empty ())
+        seen.resize ((std::size_t (1) << 24) / 64);
+
+    if (trigrams.stamp.load () < job.rebuilt)
+    {
+        // Built aside, so the render thread meanwhile finds the pages by scanning them
+        postings_t built;
+        for (std::size_t i = 0; i < job.book->pages.size (); ++i)
+        {
+            if (cancelled.load (std::memory_order_relaxed))
+                return false;
+            index_page (built, job.ids[i], job.book->pages[i]);
+        }
+        std::lock_guard<std::mutex> lock (trigrams.lock);
+        trigrams.postings.swap (built);
+        trigrams.stamp = job.stamp;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock (trigrams.lock);
+    for (auto i: job.changed)
+    {
+        // Adding more ids than needed is harmless
+        if (cancelled.load (std::memory_order_relaxed))
+            return false;
+        index_page (trigrams.postings, job.ids[i], job.book->pages[i]);
+    }
+    trigrams.stamp = job.stamp;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The pages not indexed yet, with the ids of all, for the worker to index
+
+static index_job_t
+make_index_job ()
+{
+    index_job_t job;
+    job.book = snapshot_book ();
+    job.rebuilt = rebuilt;
+    job.stamp = posted = stamps;
+    auto done = trigrams.stamp.load ();
+    job.ids.reserve (indexed.size ());
+    for (std::size_t i = 0; i < indexed.size (); ++i)
+    {
+        job.ids.push_back (indexed[i].id);
+        if (indexed[i].stamp > done)
+            job.changed.push_back (i);
+    }
+    return job;
+}
+
+static void post_index_job ();
+
+//--------------------------------------------------------------------------------------------------
+
+void
+index_pages ()
+{
+    indexed.resize (journal.pages.size ());
+    for (std::size_t i = 0; i < indexed.size (); ++i)
+        indexed[i].id = std::uint32_t (i);
+    next_id = std::uint32_t (indexed.size ());
+
+    rebuilt = ++stamps;
+    for (auto& p: indexed)
+        p.stamp = rebuilt;
+    post_index_job ();
+}
+
+bool
+index_busy ()
+{
+    return trigrams.stamp.load () < posted;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+index_page_edited (std::size_t ndx)
+{
+    if (ndx < indexed.size ())
+        indexed[ndx].stamp = ++stamps;
+}
+
+void
+index_page_inserted (std::size_t ndx)
+{
+    if (ndx <= indexed.size ())
+        indexed.insert (indexed.begin () + ndx, indexed_page_t { next_id++, ++stamps });
+}
+
+void
+index_page_erased (std::size_t ndx)
+{
+    if (ndx < indexed.size ())
+        indexed.erase (indexed.begin () + ndx);
+}
+
+void
+index_book_replaced ()
+{
+    index_pages ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static bool
+page_has (std::size_t ndx, std::string_view text)
+{
+    return find_text (journal.pages[ndx].title, text) != std::string_view::npos
+        || find_text (page_content (ndx), text) != std::string_view::npos;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Ids of the pages which may have @p text, false if it is too short to tell
+
+static bool
+lookup_ids (postings_t const& postings, std::string_view text, std::vector<std::uint32_t>& ids)
+{
+    ids.clear ();
+    if (text.size () < 3)
+        return false;
+
+    std::vector<trigram_t> wanted;
+    for (std::size_t i = 2; i < text.size (); ++i)
+        wanted.push_back (trigram_at (text, i));
+    std::sort (wanted.begin (), wanted.end ());
+    wanted.erase (std::unique (wanted.begin (), wanted.end ()), wanted.end ());
+
+    std::vector<std::vector<std::uint32_t> const*> lists;
+    for (auto t: wanted)
+    {
+        auto it = postings.find (t);
+        if (it == postings.end ())
+            return true;
+        lists.push_back (&it->second);
+    }
+    std::sort (lists.begin (), lists.end (),
+            [] (auto a, auto b) { return a->size () < b->size (); });
+
+    std::vector<std::uint32_t> common;
+    ids = *lists.front ();
+    for (std::size_t i = 1; i < lists.size () && !ids.empty (); ++i)
+    {
+        common.clear ();
+        std::set_intersection (ids.begin (), ids.end (),
+                lists[i]->begin (), lists[i]->end (), std::back_inserter (common));
+        ids.swap (common);
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Or the pages were changed behind the notifications
+
+static void
+check_indexed ()
+{
+    if (indexed.size () != journal.pages.size ())
+        index_pages ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+std::size_t
+find_page (std::string_view text)
+{
+    check_indexed ();
+    auto const npages = journal.pages.size ();
+
+    std::size_t page = 0;
+    {
+        // Rather than wait for the worker, all pages are scanned
+        std::unique_lock<std::mutex> lock (trigrams.lock, std::try_to_lock);
+        std::vector<std::uint32_t> ids;
+        bool use_index = lock.owns_lock () && lookup_ids (trigrams.postings, text, ids);
+        auto done = trigrams.stamp.load ();
+        for (; page < npages; ++page)
+        {
+            auto const& p = indexed[page];
+            if ((!use_index || p.stamp > done
+                        || std::binary_search (ids.begin (), ids.end (), p.id))
+                    && page_has (page, text))
+                break;
+        }
+    }
+
+    // The edited pages are indexed for the next time
+    if (posted < stamps)
+        post_index_job ();
+    return page;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Words of the query, split at the whitespaces
+
+static std::vector<std::string>
+query_words (std::string_view query)
+{
+    std::vector<std::string> words;
+    std::size_t i = 0;
+    while (i < query.size ())
+    {
+        auto b = query.find_first_not_of (" \t\r\n", i);
+        if (b == std::string_view::npos)
+            break;
+        auto e = std::min (query.find_first_of (" \t\r\n", b), query.size ());
+        words.emplace_back (query.substr (b, e - b));
+        i = e;
+    }
+    return words;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Matches of @p word in @p text, and where the first one is (or npos)
+
+static std::size_t
+count_matches (std::string_view text, std::string const& word, std::size_t& first)
+{
+    std::size_t n = 0;
+    first = find_folded (text, word);
+    for (auto i = first; i != std::string_view::npos;
+            i = find_folded (text, word, i + word.size ()))
+        ++n;
+    return n;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Single line of text around @p pos, not cutting the UTF-8 sequences
+
+static std::string
+make_snippet (std::string_view text, std::size_t pos)
+{
+    constexpr std::size_t before = 32, after = 96;
+    auto b = pos > before ? pos - before : 0;
+    auto e = std::min (text.size (), pos + after);
+    while (b > 0 && (std::uint8_t (text[b]) & 0xC0) == 0x80)
+        --b;
+    while (e < text.size () && (std::uint8_t (text[e]) & 0xC0) == 0x80)
+        ++e;
+
+    std::string s = b ? "..." : "";
+    for (auto c: text.substr (b, e - b))
+        s += c == '\n' || c == '\r' || c == '\t' ? ' ' : c;
+    if (e < text.size ())
+        s += "...";
+    return s;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Background indexing and searching, alike to the book saving: at most one of each running, and
+/// one waiting
+
+struct searcher_t
+{
+    std::mutex lock;
+    std::condition_variable wake;
+    bool started;
+    index_job_t job;                    ///< Waiting, if it has a book, the query runs over it
+    bool busy;                          ///< A job is being run
+    std::string query;
+    std::size_t top;
+    std::atomic<unsigned> requested;    ///< Request tickets, also read by the running query
+    unsigned finished;
+    std::vector<search_hit_t> hits;     ///< Of the last finished request
+    bool fresh;                         ///< Hits not taken yet
+};
+
+/// Never destroyed, as the detached worker may still wait on it at exit
+static searcher_t& searcher = *new searcher_t {};
+
+/// Pages of the job which may have all of the @p words. Only the worker changes the index, so it
+/// reads it unlocked, and it has all pages of the job in by now.
+
+static std::vector<std::size_t>
+candidate_pages (index_job_t const& job, std::vector<std::string> const& words)
+{
+    std::vector<bool> possible (job.ids.size (), true);
+    std::vector<std::uint32_t> ids;
+    for (auto const& w: words)
+        if (lookup_ids (trigrams.postings, w, ids))
+            for (std::size_t i = 0; i < possible.size (); ++i)
+                possible[i] = possible[i]
+                    && std::binary_search (ids.begin (), ids.end (), job.ids[i]);
+
+    std::vector<std::size_t> pages;
+    for (std::size_t i = 0; i < possible.size (); ++i)
+        if (possible[i])
+            pages.push_back (i);
+    return pages;
+}
+
+static std::vector<search_hit_t>
+run_search (index_job_t const& job, std::string const& query, std::size_t top, unsigned ticket)
+{
+    auto const& book = *job.book;
+    auto words = query_words (query);
+    auto candidates = candidate_pages (job, words);
+
+    std::vector<search_hit_t> hits;
+    for (auto page: candidates)
+    {
+        if (searcher.requested.load (std::memory_order_relaxed) != ticket
+                || cancelled.load (std::memory_order_relaxed))
+            return {};
+        if (page >= book.pages.size ())
+            break;
+
+        auto title = book.pages[page].title.view, content = book.pages[page].content.view;
+        search_hit_t hit { page, 0, {} };
+        std::string_view where;
+        std::size_t at = std::string_view::npos;
+        for (std::size_t i = 0; i < words.size (); ++i)
+        {
+            std::size_t ft, fc;
+            // Titles are what the chapters are known by, hence weight more
+            auto n = 8 * count_matches (title, words[i], ft)
+                   + count_matches (content, words[i], fc);
+            if (!n)
+            {
+                hit.matches = 0;
+                break;
+            }
+            hit.matches += n;
+            if (at == std::string_view::npos)
+            {
+                where = fc != std::string_view::npos ? content : title;
+                at = fc != std::string_view::npos ? fc : ft;
+            }
+        }
+        if (!hit.matches)
+            continue;
+        hit.snippet = make_snippet (where, at);
+        hits.push_back (std::move (hit));
+    }
+
+    auto n = std::min (top, hits.size ());
+    std::partial_sort (hits.begin (), hits.begin () + n, hits.end (), [] (auto& a, auto& b) {
+        return a.matches != b.matches ? a.matches > b.matches : a.page < b.page;
+    });
+    hits.resize (n);
+    return hits;
+}
+
+static void
+searcher_loop ()
+{
+    std::unique_lock<std::mutex> lock (searcher.lock);
+    for (;;)
+    {
+        // A query always comes with the snapshot it is run over
+        searcher.wake.wait (lock, [] { return searcher.job.book != nullptr; });
+        auto job = std::move (searcher.job);
+        searcher.job = {};
+        searcher.busy = true;
+        cancelled = false;
+        bool searching = searcher.requested != searcher.finished;
+        auto query = searcher.query;
+        auto top = searcher.top;
+        unsigned ticket = searcher.requested;
+        lock.unlock ();
+
+        std::vector<search_hit_t> hits;
+        if (update_index (job) && searching)
+            hits = run_search (job, query, top, ticket);
+        // Not kept, as it may hold the mapped book
+        job = {};
+
+        lock.lock ();
+        searcher.busy = false;
+        // Only if no newer query came meanwhile, else it is run next, and not if it was cancelled,
+        // as it is then run again over a snapshot without the mapped book
+        if (searching && searcher.requested == ticket && !cancelled)
+        {
+            searcher.hits = std::move (hits);
+            searcher.finished = ticket;
+            searcher.fresh = true;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Under the searcher lock
+
+static void
+start_searcher ()
+{
+    if (!searcher.started)
+    {
+        // Detached, as there is no orderly DLL shutdown to join it
+        std::thread (searcher_loop).detach ();
+        searcher.started = true;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Replaces the job still waiting, if any, as this one has all of its pages too
+
+static void
+post_index_job ()
+{
+    auto job = make_index_job ();
+    std::lock_guard<std::mutex> lock (searcher.lock);
+    start_searcher ();
+    searcher.job = std::move (job);
+    searcher.wake.notify_one ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+search_async (std::string const& query, std::size_t top)
+{
+    // The changed pages are indexed, and the candidates picked, by the worker
+    check_indexed ();
+    auto job = make_index_job ();
+
+    std::lock_guard<std::mutex> lock (searcher.lock);
+    start_searcher ();
+    searcher.job = std::move (job);
+    searcher.query = query;
+    searcher.top = top;
+    ++searcher.requested;
+    searcher.wake.notify_one ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+release_book_snapshots ()
+{
+    bool again;
+    {
+        std::lock_guard<std::mutex> lock (searcher.lock);
+        again = searcher.job.book || searcher.busy;
+        searcher.job = {};
+        if (searcher.busy)
+            cancelled = true;
+    }
+    // The pending query, if any, stays requested and is run over the new job
+    if (again)
+        post_index_job ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+take_search_results (std::vector<search_hit_t>& hits)
+{
+    std::lock_guard<std::mutex> lock (searcher.lock);
+    if (!searcher.fresh || searcher.finished != searcher.requested)
+        return false;
+    hits = std::move (searcher.hits);
+    searcher.fresh = false;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -25,14 +25,12 @@
  * @details
  */
 
-#include <sse-imgui/sse-imgui.h>
+#include "sse-journal.hpp"
 #include <sse-gui/sse-gui.h>
 #include <sse-hooks/sse-hooks.h>
 #include <utils/winutils.hpp>
 
 #include <fstream>
-#include <iomanip>
-#include <chrono>
 #include <array>
 #include <cstdint>
 typedef std::uint32_t UInt32;
@@ -47,83 +45,35 @@ static PluginHandle plugin = 0;
 /// To communicate with the other SKSE plugins.
 static SKSEMessagingInterface* messages = nullptr;
 
-/// Log file in pre-defined location
-static std::ofstream logfile;
-
-/// [shared] Local initialization
-sseimgui_api sseimgui = {};
-
 /// [shared] Local initialization
 sseh_api sseh = {};
 
-/// [shared] Table with pointers
-imgui_api imgui = {};
-
-/// [shared] Reports current log file path (for user friendly messages)
-std::string logfile_path;
-
-/// [shared] Kind of message queue to be polled from the renderer for custom commands execution
-std::string journal_message;
-
 //--------------------------------------------------------------------------------------------------
 
 static void
 open_log ()
 {
-    logfile_path = "";
-    if (known_folder_path (FOLDERID_Documents, logfile_path))
+    std::string path;
+    if (known_folder_path (FOLDERID_Documents, path))
     {
         // Before plugins are loaded, SKSE takes care to create the directiories
-        logfile_path += "\\My Games\\Skyrim Special Edition\\SKSE\\";
+        path += "\\My Games\\Skyrim Special Edition\\SKSE\\";
     }
-    logfile_path += "sse-journal.log";
-    logfile.open (logfile_path);
-}
-
-//--------------------------------------------------------------------------------------------------
-
-decltype(logfile)&
-log ()
-{
-    // MinGW 4.9.1 have no std::put_time()
-    using std::chrono::system_clock;
-    auto now_c = system_clock::to_time_t (system_clock::now ());
-    auto loc_c = std::localtime (&now_c);
-    logfile << '['
-            << 1900 + loc_c->tm_year
-            << '-' << std::setw (2) << std::setfill ('0') << loc_c->tm_mon
-            << '-' << std::setw (2) << std::setfill ('0') << loc_c->tm_mday
-            << ' ' << std::setw (2) << std::setfill ('0') << loc_c->tm_hour
-            << ':' << std::setw (2) << std::setfill ('0') << loc_c->tm_min
-            << ':' << std::setw (2) << std::setfill ('0') << loc_c->tm_sec
-        << "] ";
-    return logfile;
-}
-
-//--------------------------------------------------------------------------------------------------
-
-void
-journal_version (int* maj, int* min, int* patch, const char** timestamp)
-{
-    constexpr std::array<int, 3> ver = {
-#include "../VERSION"
-    };
-    if (maj) *maj = ver[0];
-    if (min) *min = ver[1];
-    if (patch) *patch = ver[2];
-    if (timestamp) *timestamp = JOURNAL_TIMESTAMP; //"2019-04-15T08:37:11.419416+00:00"
+    open_logfile (path + "sse-journal.log");
 }
 
 //--------------------------------------------------------------------------------------------------
 
-/// SSE-MapTrack may send message with a command to execute, from within its rendering loop
+/// Commands to execute, from any mod and any thread, see commands.cpp. All else, as the
+/// broadcasts of the other mods, is left alone.
 
 static void
 handle_journal_message (SKSEMessagingInterface::Message* m)
 {
-    if (m->type != 1 || m->dataLen < 1)
+    command_kind kind;
+    if (m->dataLen < 1 || !m->sender || !message_command (m->sender, m->type, kind))
         return;
-    journal_message = reinterpret_cast<const char*> (m->data);
+    post_command (kind, std::string_view (reinterpret_cast<const char*> (m->data), m->dataLen));
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -133,7 +83,7 @@ handle_sseimgui_message (SKSEMessagingInterface::Message* m)
 {
     if (m->type != SSEIMGUI_API_VERSION)
     {
-        log () << "Unsupported SSEIMGUI interface v" << m->type
+        log (log_level::error) << "Unsupported SSEIMGUI interface v" << m->type
                << " (it is not v" << SSEIMGUI_API_VERSION
                 << "). Bailing out." << std::endl;
         return;
@@ -145,7 +95,7 @@ handle_sseimgui_message (SKSEMessagingInterface::Message* m)
     sseimgui.version (nullptr, &maj, nullptr, nullptr);
     if (maj < 1)
     {
-        log () << "SSE-Journal needs SSE-ImGui 1.1 or later." << std::endl;
+        log (log_level::error) << "SSE-Journal needs SSE-ImGui 1.1 or later." << std::endl;
         return;
     }
 
@@ -155,7 +105,7 @@ handle_sseimgui_message (SKSEMessagingInterface::Message* m)
     extern bool setup ();
     if (!setup ())
     {
-        log () << "Unable to initialize SSE Journal" << std::endl;
+        log (log_level::error) << "Unable to initialize SSE Journal" << std::endl;
         return;
     }
 
@@ -170,7 +120,7 @@ handle_sseh_message (SKSEMessagingInterface::Message* m)
 {
     if (m->type != SSEH_API_VERSION)
     {
-        log () << "Unsupported SSEH interface v" << m->type
+        log (log_level::error) << "Unsupported SSEH interface v" << m->type
                << " (it is not v" << SSEH_API_VERSION
                 << "). Bailing out." << std::endl;
         return;
@@ -191,7 +141,7 @@ handle_skse_message (SKSEMessagingInterface::Message* m)
     log () << "SKSE Post Load." << std::endl;
     messages->RegisterListener (plugin, "SSEH", handle_sseh_message);
     messages->RegisterListener (plugin, "SSEIMGUI", handle_sseimgui_message);
-    messages->RegisterListener (plugin, "sse-maptrack", handle_journal_message);
+    messages->RegisterListener (plugin, nullptr, handle_journal_message);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -29,49 +29,373 @@
 #define SSEJOURNAL_HPP
 
 #include <sse-imgui/sse-imgui.h>
-#include <utils/winutils.hpp>
-
-#include <d3d11.h>
+#include <utils/strutils.hpp>
 
 #include <memory>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <concepts>
 #include <map>
 #include <vector>
 #include <utility>
+#include <initializer_list>
+#include <type_traits>
 #include <functional>
 
 //--------------------------------------------------------------------------------------------------
 
-// skse.cpp
+/// Only handed around, the D3D11 calls are left to the plugin and the platform layer
+struct ID3D11ShaderResourceView;
+
+struct page_t;
+struct shared_text;
+
+//--------------------------------------------------------------------------------------------------
+
+// journal.cpp
 
 void journal_version (int* maj, int* min, int* patch, const char** timestamp);
 
-extern std::ofstream& log ();
 extern std::string logfile_path;
-extern std::string journal_message;
 
 extern imgui_api imgui;
 extern sseimgui_api sseimgui;
 
 //--------------------------------------------------------------------------------------------------
 
+/**
+ * Bounded queue for any number of producing threads and a single consuming one, without locks
+ * (after D. Vyukov). The items are swapped in and out, so their buffers keep being reused.
+ */
+template<class T, std::size_t N>
+class mpsc_queue
+{
+public:
+    mpsc_queue ()
+    {
+        for (std::size_t i = 0; i < N; ++i)
+            slots[i].sequence.store (i, std::memory_order_relaxed);
+    }
+
+    /// Any thread. Gets back what the slot had, unless full.
+    bool push (T& item)
+    {
+        auto pos = head.load (std::memory_order_relaxed);
+        for (;;)
+        {
+            auto sequence = slots[pos % N].sequence.load (std::memory_order_acquire);
+            auto diff = std::intptr_t (sequence) - std::intptr_t (pos);
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = head.load (std::memory_order_relaxed);
+        }
+        auto& slot = slots[pos % N];
+        std::swap (slot.item, item);
+        slot.sequence.store (pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// The consuming thread only. Leaves @p item in the slot for the next push, unless empty.
+    bool pop (T& item)
+    {
+        auto& slot = slots[tail % N];
+        if (slot.sequence.load (std::memory_order_acquire) != tail + 1)
+            return false;
+        std::swap (slot.item, item);
+        slot.sequence.store (tail + N, std::memory_order_release);
+        ++tail;
+        return true;
+    }
+
+    /// Started to be pushed so far
+    std::size_t pushed () const { return head.load (std::memory_order_relaxed); }
+    /// The consuming thread only
+    std::size_t popped () const { return tail; }
+
+private:
+    struct slot_t
+    {
+        std::atomic<std::size_t> sequence;  ///< Equals the position once free, plus one if full
+        T item;
+    };
+    std::array<slot_t, N> slots;
+    std::atomic<std::size_t> head { 0 };
+    std::size_t tail = 0;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+// logger.cpp
+
+enum class log_level { debug, info, warning, error };
+
+/// Until opened, the log goes nowhere
+void open_logfile (std::string const& path);
+/// A record for the log file, handed to its writer thread at each flush (as by std::endl)
+std::ostream& log (log_level level = log_level::info);
+/// Waits until the records handed over so far are in the file, not meant for the render thread
+void flush_log ();
+/// Records of a lower level are dropped, info by default
+void set_log_threshold (log_level level);
+log_level log_threshold ();
+
+//--------------------------------------------------------------------------------------------------
+
+// commands.cpp
+
+/// As the SKSE message types of the commands
+enum class command_kind : std::uint32_t { find = 1, goto_page, append, new_entry };
+
+/// Any mod may send the command of a kind as this plus the kind, as message types below are used
+/// by the broadcasts of all sorts of mods. The bare kinds are taken only from #command_senders.
+constexpr std::uint32_t command_message_base = 0x4A524E00; // "JRN"
+extern const std::array<const char*, 1> command_senders;
+
+/// The command an SKSE message of @p type from @p sender is, false if it is none of ours
+bool message_command (std::string_view sender, std::uint32_t type, command_kind& kind);
+/// From any thread, false if malformed or if too many are waiting already
+bool post_command (command_kind kind, std::string_view data);
+/// On the render thread, at most @p budget of them, true if the journal should be brought up
+bool run_commands (std::size_t budget);
+
+//--------------------------------------------------------------------------------------------------
+
+// platform.cpp
+
+/// Replaces @p destination with @p source, throws on failure
+void replace_file (std::string const& source, std::string const& destination);
+/// Throws on failure, though a missing file is not one
+void remove_file (std::string const& file);
+/// Including file permissions and etc. errors
+bool file_exists (std::string const& file);
+
+/// Enough to tell whether a file changed, the time is in native units
+struct file_info_t
+{
+    std::string name;
+    std::uint64_t size, mtime;
+};
+
+/// False for missing files and directories, otherwise the name is set to @p file
+bool file_info (std::string const& file, file_info_t& info);
+/// The regular files in @p directory (with a trailing separator) whose names end with @p extension
+std::vector<file_info_t> list_files (std::string const& directory, std::string const& extension);
+/// Maps the whole file for reading, throws on failure (empty files too)
+const char* map_file (std::string const& file, std::size_t& size);
+void unmap_file (const char* view, std::size_t size);
+void release_texture (ID3D11ShaderResourceView* texture);
+
+//--------------------------------------------------------------------------------------------------
+
+// jsonwriter.cpp
+
+/// Streams JSON straight into a file, as nlohmann::json::dump () would print it
+class json_writer
+{
+public:
+    enum class style { pretty, compact };
+
+    explicit json_writer (std::ostream& os, style s = style::pretty);
+    ~json_writer ();
+
+    json_writer& begin_object ();
+    json_writer& end_object ();
+    json_writer& begin_array ();
+    json_writer& end_array ();
+    json_writer& key (std::string_view k);
+
+    json_writer& value (std::string_view v);
+    json_writer& value (const char* v) { return value (std::string_view (v)); }
+    json_writer& value (std::string const& v) { return value (std::string_view (v)); }
+    json_writer& value (bool v);
+    json_writer& value (double v);
+    json_writer& value (float v) { return value (double (v)); }
+
+    template<std::integral T>
+    json_writer& value (T v)
+    {
+        if constexpr (std::is_signed_v<T>) return integer ((long long) v);
+        else return integer ((unsigned long long) v);
+    }
+
+    /// Throws on I/O errors, hence should be called explicitly at the end
+    void flush ();
+
+private:
+    static constexpr std::size_t buffer_size = 64 * 1024;
+
+    std::ostream& os;
+    std::string buffer;
+    std::vector<bool> levels;   ///< Per nesting level: is still empty?
+    std::size_t indent;
+    bool after_key = false;
+
+    json_writer& integer (long long v);
+    json_writer& integer (unsigned long long v);
+    void element ();
+    void open (char c);
+    void close (char c);
+    void escaped (std::string_view s);
+    void newline ();
+    void put (std::string_view s);
+    void put (char c);
+};
+
+//--------------------------------------------------------------------------------------------------
+
 // fileio.cpp
 
 bool save_text (std::string const& destination);
-bool save_book (std::string const& destination);
+bool save_book (std::string const& destination,
+        json_writer::style style = json_writer::style::pretty);
+void save_book_async (std::string const& destination);
 bool load_book (std::string const& source);
+/// The book shown at start, an empty one of two pages if it can not be loaded
+void load_default_book (std::string const& source);
 bool load_takenotes (std::string const& source);
+/// Thread safe, texts only, throws on failure
+std::vector<page_t> read_book_pages (std::string const& source, std::ostream& messages);
+/// Where the changes since the last full save of @p book are appended to
+std::string edit_log_file (std::string const& book);
 bool save_settings ();
 bool load_settings ();
 bool save_variables ();
 bool load_variables ();
 
+/// Progress of the save_book_async () calls, a failure is reported (and logged) only once
+enum class save_status { idle, saving, failed };
+save_status book_save_status ();
+
 extern std::string journal_directory;
 extern std::string books_directory;
 extern std::string default_book;
 extern std::string settings_location;
 extern std::string images_directory;
+extern std::string library_location;
+
+//--------------------------------------------------------------------------------------------------
+
+// text.cpp
+
+/**
+ * Title or content of a page: one zero terminated buffer which ImGui edits in place, but with
+ * the text length kept explicitly. Spare room is made only when the text grows. The buffer is
+ * shared with the snapshots taken of it, and copied only if changed while one still has it.
+ */
+class page_text
+{
+public:
+    page_text () = default;
+    page_text (std::string_view s) { assign (s); }
+    page_text (std::string&& s) { assign (std::move (s)); }
+    page_text (const char* s) { assign (std::string_view (s)); }
+
+    page_text& operator= (std::string_view s) { assign (s); return *this; }
+    page_text& operator= (std::string&& s) { assign (std::move (s)); return *this; }
+    page_text& operator= (const char* s) { assign (std::string_view (s)); return *this; }
+    page_text& operator+= (std::string_view s) { append (s); return *this; }
+
+    /// Exactly as big as needed, as most pages are never edited
+    void assign (std::string_view s);
+    void assign (std::string&& s);
+    /// Amortized constant time per appended byte
+    void append (std::string_view s);
+
+    std::size_t size () const { return length; }
+    bool empty () const { return !length; }
+    const char* c_str () const { return buffer ? buffer->c_str () : ""; }
+    std::string_view view () const { return { c_str (), length }; }
+    operator std::string_view () const { return view (); }
+
+    /// The ImGui edit buffer, with room for capacity () bytes and the terminating zero
+    char* data () { return own ().data (); }
+    std::size_t capacity () const { return buffer ? buffer->size () : 0; }
+    /// Makes room for at least @p n bytes, growing geometrically
+    void reserve (std::size_t n);
+    /// Picks up the new length once ImGui has changed the buffer
+    void edited ();
+
+    /// The text as it is now, unchanged by the later edits of this one
+    shared_text share () const;
+
+private:
+    /// The buffer, copied first if anything else still has it
+    std::string& own ();
+
+    /// Its size is the capacity, the text is zero terminated at #length
+    std::shared_ptr<std::string> buffer;
+    std::size_t length = 0;
+};
+
+/// Anything else than spaces and control characters?
+bool visible_symbols (std::string_view s);
+/// Breaks the lines longer than @p width bytes at their last whitespace
+std::string greedy_word_wrap (std::string_view source, unsigned width);
+void replace_all (std::string& data, std::string const& search, std::string const& replace);
+
+/**
+ * A format string with % substitutions, as the variables have, parsed once into literal and
+ * substitution steps. At each % the longest matching substitution name is taken, anything else
+ * stays as it is.
+ */
+class format_program
+{
+public:
+    /// Does nothing if @p format is what was compiled already
+    void compile (std::string_view format, std::initializer_list<std::string_view> names);
+    std::string_view source () const { return format; }
+    /// Whether the compiled format has the substitution of the given name index
+    bool uses (int substitution) const
+    {
+        for (auto const& s: steps)
+            if (s.substitution == substitution)
+                return true;
+        return false;
+    }
+
+    /// Appends the literals to @p out, and for each substitution calls @p value (index, out)
+    template<class F>
+    void run (std::string& out, F&& value) const
+    {
+        for (auto const& s: steps)
+            if (s.substitution < 0)
+                out.append (format, s.offset, s.size);
+            else
+                value (s.substitution, out);
+    }
+
+private:
+    struct step_t
+    {
+        std::uint32_t offset, size;     ///< Literal part of the format
+        int substitution;               ///< Index of the name, or -1 for a literal
+    };
+    std::string format;
+    std::vector<step_t> steps;
+    bool compiled = false;
+};
+
+/// Lines of a text as ImGui draws them in the page: where each starts, and where its glyphs stop
+/// fitting in the width, for the font and size it was laid out with
+struct text_layout_t
+{
+    std::vector<std::uint32_t> starts, ends;
+    ImFont const* font = nullptr;
+    float size = 0, width = 0;
+};
+
+void layout_text (text_layout_t& layout, std::string_view text, ImFont const& font,
+        float size, float width);
 
 //--------------------------------------------------------------------------------------------------
 
@@ -82,14 +406,253 @@ struct variable_t
     bool deletable;
     int fuid;   ///< Unique identifier of functions, allows loading of custom vars
     std::string name, params, info;
-    std::function<std::string (variable_t*)> apply;   ///< Avoids inheritance, dynamic mem & etc.
-    inline std::string operator () () { return apply (this); }
+    std::function<void (variable_t*)> apply;    ///< Into #output. Avoids inheritance & etc.
+    /// Appends to the key what #output depends on besides the params: the game minute, the
+    /// second... Nothing if unset
+    std::function<void (variable_t*, std::string& key)> inputs;
+    format_program program;     ///< The params, compiled on evaluation if they changed
+    std::string output;         ///< Of the last evaluation, its room reused by the next ones
+    inline std::string const& operator () () { apply (this); return output; }
+    std::string key;            ///< Name, params and inputs, as the placeholders last checked
+    bool stale = true;          ///< The output the placeholders show is to be evaluated again
 };
 
+std::vector<variable_t> make_variables ();
+
+//--------------------------------------------------------------------------------------------------
+
+// textscan.cpp
+
+/// Next @p c in @p s, or npos
+std::size_t find_byte (std::string_view s, char c);
+/// First byte other than a space or a control character, or npos
+std::size_t find_visible (std::string_view s);
+std::size_t count_newlines (std::string_view s);
+/// As std::string_view::find does
+std::size_t find_text (std::string_view text, std::string_view word, std::size_t from = 0);
+/// Same, but the ASCII letters match regardless of their case
+std::size_t find_folded (std::string_view text, std::string_view word, std::size_t from = 0);
+bool valid_utf8 (std::string_view s);
+
+/// Kernels in use: "avx2", "sse2" or "scalar", the best the CPU has by default
+const char* text_kernels ();
+/// Empty @p name picks the best, false if the CPU lacks the named ones
+bool use_text_kernels (std::string_view name);
+
+//--------------------------------------------------------------------------------------------------
+
+// search.cpp
+
+/// First page with @p text in its title or content, or the page count if there is none
+std::size_t find_page (std::string_view text);
+/// Drops the index and builds it again on the worker, as done for each replaced book
+void index_pages ();
+/// Whether the worker is still indexing, the pages not indexed yet are searched by scanning them
+bool index_busy ();
+
+/// Called with the book.cpp notifications of the same name
+void index_page_edited (std::size_t ndx);
+void index_page_inserted (std::size_t ndx);
+void index_page_erased (std::size_t ndx);
+void index_book_replaced ();
+
+struct search_hit_t
+{
+    std::size_t page;
+    std::size_t matches;    ///< Of all the query words, those in the title count more
+    std::string snippet;    ///< Single line of text around the first match
+};
+
+/// Searches for the pages having all words of @p query, on a worker. The query still running,
+/// if any, is abandoned.
+void search_async (std::string const& query, std::size_t top = 50);
+/// Moves out the best hits of the newest query, false if it has not finished yet (or was taken)
+bool take_search_results (std::vector<search_hit_t>& hits);
+/// Cancels the work over the snapshots taken so far, for the mapped book to be let go of. What was
+/// cancelled is handed again to the worker, with a new snapshot.
+void release_book_snapshots ();
+
+//--------------------------------------------------------------------------------------------------
+
+// library.cpp
+
+struct library_hit_t
+{
+    std::string file;       ///< In the books directory
+    std::size_t page;
+    std::string title;
+};
+
+/// Indexes on a worker the books which changed since the last refresh (or game)
+void refresh_library_async ();
+/// Whether a refresh is still running, logs what went wrong in the ones done
+bool library_busy ();
+std::size_t library_books ();
+/// Pages having for each word of @p query one starting with it, in the book and page order
+std::vector<library_hit_t> library_search (std::string const& query, std::size_t top = 100);
+
+//--------------------------------------------------------------------------------------------------
+
+// trace.cpp
+
+struct trace_arg_t
+{
+    const char* name;
+    std::uint64_t value;
+};
+
+/// Enabling starts a new trace
+void enable_tracing (bool on);
+bool tracing_enabled ();
+std::size_t traced_events ();
+/// Times are of the steady clock, at most two @p args are kept
+void trace_span (const char* name, std::int64_t begin, std::int64_t end,
+                 trace_arg_t const* args, std::size_t count);
+/// As Chrome trace_event JSON
+bool write_trace (std::string const& file);
+
+//--------------------------------------------------------------------------------------------------
+
+// profiler.cpp
+
+/// Adds the time until the end of the scope to @p section (a string literal) in this frame,
+/// and makes a span of it in the trace
+class profile_scope
+{
+public:
+    explicit profile_scope (const char* section);
+    ~profile_scope ();
+    profile_scope (profile_scope const&) = delete;
+    profile_scope& operator= (profile_scope const&) = delete;
+
+    /// For the trace, as the page count or the bytes read: at most two, @p name a string literal
+    void arg (const char* name, std::uint64_t value);
+
+private:
+    const char* name;
+    int section;
+    bool traced;
+    std::uint32_t count;
+    std::int64_t start;
+    std::array<trace_arg_t, 2> args;
+};
+
+/// Ends the frame and starts the next, must be called on the render thread which is then timed
+void profile_frame ();
+void enable_profiler (bool on);
+bool profiler_enabled ();
+
+struct profile_stats_t
+{
+    const char* section;
+    std::size_t frames;     ///< Recorded frames with the section in them
+    float min, avg, p99, max;
+};
+
+/// Over the last recorded frames, in milliseconds
+std::vector<profile_stats_t> profile_stats ();
+/// Milliseconds per recorded frame, oldest first, NaN where the section did not run
+std::vector<float> profile_history (const char* section);
+/// How many of the recorded frames took each @p bucket_ms wide range of milliseconds in the
+/// section, from zero on, the last of the @p buckets taking all longer ones too
+std::vector<float> profile_histogram (const char* section, float bucket_ms, std::size_t buckets);
+/// As CSV, a row per frame
+bool dump_profile (std::string const& file);
+
+//--------------------------------------------------------------------------------------------------
+
+// gamestate.cpp
+
+/// Is @p p worth following: not null, in the user address space and aligned as its object
+bool plausible_pointer (std::uintptr_t p, std::size_t alignment = alignof (void*));
+
+/// Obtains an address to a relative object, to a relative object, to a relative object, to a...
+template<class T, unsigned N = 1>
+struct relocation
+{
+    std::array<std::uintptr_t, 1+N> offsets;
+
+    /// Null if some link of the chain does not look like a pointer
+    T obtain (std::uintptr_t base) const
+    {
+        if (!offsets[0] || !plausible_pointer (base, 1))
+            return nullptr;
+        std::uintptr_t that = base;
+        for (unsigned i = 0; i < N; ++i)
+        {
+            if (!plausible_pointer (that + offsets[i]))
+                return nullptr;
+            that = *reinterpret_cast<std::uintptr_t*> (that + offsets[i]);
+            if (!plausible_pointer (that, 1))
+                return nullptr;
+        }
+        if (!plausible_pointer (that + offsets[N], alignof (std::remove_pointer_t<T>)))
+            return nullptr;
+        return reinterpret_cast<T> (that + offsets[N]);
+    }
+};
+
+/// Where the game keeps what the variables show, see variables.cpp for the details
+struct game_memory_t
+{
+    std::uintptr_t base;    ///< Of SkyrimSE.exe, or of a mock image with the same layout
+    relocation<float*> epoch;
+    relocation<float*> position;
+    relocation<const char*, 3> cell;
+    relocation<const char*, 3> worldspace;
+};
+
+extern game_memory_t game_memory;
+
+/// The game memory as of some frame
+struct game_state_t
+{
+    unsigned tick;          ///< When taken
+    bool has_epoch, has_position;
+    float epoch;            ///< Days since the game start, as Papyrus.GetCurrentGameTime () gives
+    std::array<float, 3> position;
+    std::string cell, worldspace;   ///< Names, empty if none
+};
+
+/// Starts a new frame, the next game_state() call reads the game memory again
+void tick_game_state ();
+/// Taken at most once per tick_game_state()
+game_state_t const& game_state ();
+
+/// Formats with the % substitutions of the Player position variable, @p out replaced
+void compile_player_location (format_program& program, std::string_view format);
+void player_location (std::string& out, format_program const& program, game_state_t const& gs);
+/// Appends what of @p gs the output of player_location() shows
+void player_location_inputs (std::string& key, game_state_t const& gs);
+
+//--------------------------------------------------------------------------------------------------
+
+// placeholders.cpp
+
+/// Whether @p text may have some {{variable name}} placeholder
+bool has_placeholders (std::string_view text);
+/// Changes when some output the placeholders show may have, checked at most once per frame
+unsigned placeholders_revision ();
+/// Copies @p text into @p out, the placeholders of known variables replaced by their outputs
+void expand_placeholders (std::string& out, std::string_view text);
+/// Replaces the placeholders of the page contents by their outputs, returns the pages changed
+std::size_t freeze_placeholders ();
+
+//--------------------------------------------------------------------------------------------------
+
+// calendar.cpp
+
 /// @see https://en.cppreference.com/w/cpp/chrono/c/strftime
 std::string local_time (const char* format);
 
-std::vector<variable_t> make_variables ();
+/// The game time @p epoch (days since the game start, as Papyrus.GetCurrentGameTime () gives)
+/// formatted with the custom % substitutions of the Game time variable
+std::string game_time (std::string_view format, float epoch);
+/// The same into @p out, replacing it, with the format compiled once by compile_game_time()
+void game_time (std::string& out, format_program const& program, float epoch);
+void compile_game_time (format_program& program, std::string_view format);
+/// Appends what of @p epoch the output of @p program shows: the minute, or the exact value
+void game_time_inputs (std::string& key, format_program const& program, float epoch);
 
 //--------------------------------------------------------------------------------------------------
 
@@ -101,6 +664,7 @@ class button_t
     ImVec2 tl, sz, align;
     const char *label, *label_end;
     std::uint32_t hover_tint;
+    bool hover = false;
 
 public:
     static ImVec2 wpos, wsz;
@@ -109,7 +673,11 @@ public:
             float tlx, float tly, float szx, float szy,
             std::uint32_t hover, float ax = .5f, float ay = .5f);
 
+    /// The input part only, true if pressed
     bool draw ();
+    /// The looks, apart so they can be cached: the hover highlight and the label
+    void paint () const;
+    bool hovered () const { return hover; }
 };
 
 struct image_t
@@ -123,7 +691,7 @@ struct image_t
 
 struct page_t
 {
-    std::string title, content;
+    page_text title, content;
     image_t image;
 };
 
@@ -140,7 +708,134 @@ struct font_t
     ImFont* imfont; ///< Actual font with its settings (apart from #color)
 };
 
-extern bool obtain_image (std::string const& file, image_t& img);
+//--------------------------------------------------------------------------------------------------
+
+// book.cpp
+
+class mapped_book;
+
+/// Immutable text, owned by a string or by the mapped book it points into
+struct shared_text
+{
+    std::shared_ptr<const void> owner;
+    std::string_view view;
+};
+
+/// Immutable copy of a page, safe to be handed to background workers
+struct page_snapshot_t
+{
+    shared_text title, content;
+    image_t image;
+    std::string image_file;
+};
+
+struct book_snapshot_t
+{
+    unsigned generation;    ///< Increases with each snapshot taken
+    unsigned current;
+    std::vector<page_snapshot_t> pages;
+    /// The mapped book being overwritten, let go of here but maybe still held by older snapshots
+    std::weak_ptr<const mapped_book> unmapped;
+};
+
+/// All changes of the pages go through, or are reported to, these
+void page_edited (std::size_t ndx);
+void insert_page (std::size_t ndx);
+void erase_page (std::size_t ndx);
+/// Pages with a @p sources index other than -1 are left to be loaded from that page of @p book
+void book_replaced (std::shared_ptr<const mapped_book> book = {},
+        std::vector<std::size_t> const& sources = {});
+
+/// Changes with each of the above, for what is derived from the pages to tell it is out of date
+unsigned book_revision ();
+
+/// Loads the page if not yet, must be called before its content or image are used
+page_t& touch_page (std::size_t ndx);
+/// Loads ahead one of the pages around the spread starting at @p ndx
+void prefetch_pages (std::size_t ndx);
+/// Read-only content of a page, whether loaded or not
+std::string_view page_content (std::size_t ndx);
+
+/// A row of the Chapters list
+struct chapter_t
+{
+    std::size_t page;
+    bool blank;     ///< The title has nothing to show
+};
+
+/// Pages whose titles start with @p prefix, ignoring the case of the ASCII letters, all of them if
+/// empty. Valid until the next call or change of the pages.
+std::vector<chapter_t> const& chapter_list (std::string_view prefix = {});
+
+/// Textures are shared by file across the book, hence counted
+bool obtain_image (std::string const& file, image_t& img);
+void release_image (image_t& img);
+
+/// The pages now match @p file, plus its edit log of @p log_size bytes
+void book_saved (std::string const& file, std::size_t log_size = 0);
+std::string const& book_saved_file ();
+std::size_t edit_log_size ();
+
+/// Edit log records for all changes since the last save, which then are considered saved
+std::string take_edit_records ();
+
+/// Pass the file to be saved, if it may be the mapped book, which then is no more used. The texts
+/// are shared, not copied, see page_text.
+std::shared_ptr<const book_snapshot_t> snapshot_book (std::string const& destination = {});
+
+//--------------------------------------------------------------------------------------------------
+
+// jbook.cpp
+
+/// Text stored in a binary book, always followed by a terminating zero
+struct jbook_blob
+{
+    std::uint64_t offset, size;
+};
+
+struct jbook_page
+{
+    jbook_blob title, content, image_file;
+    std::uint32_t background, tint;
+    std::array<float, 4> uv, xy;
+};
+
+/// Binary book file start, followed by the page table, followed by the texts
+struct jbook_header
+{
+    char magic[8];
+    std::uint32_t format;
+    std::uint32_t major, minor, patch;
+    std::uint32_t current, size;
+    std::uint64_t pages;    ///< Offset of the page table
+};
+
+/// Read-only binary book, memory mapped, so its texts are read without copying
+class mapped_book
+{
+public:
+    /// Throws if the file can not be mapped or is not a valid binary book
+    explicit mapped_book (std::string const& file);
+    ~mapped_book ();
+    mapped_book (mapped_book const&) = delete;
+    mapped_book& operator= (mapped_book const&) = delete;
+
+    std::string const& path () const { return file_path; }
+    jbook_header const& header () const { return *reinterpret_cast<jbook_header const*> (view); }
+    std::size_t size () const { return header ().size; }
+    jbook_page const& page (std::size_t ndx) const;
+    std::string_view text (jbook_blob const& blob) const { return { view + blob.offset, blob.size }; }
+
+private:
+    std::string file_path;
+    const char* view;
+    std::size_t view_size;
+};
+
+void write_jbook (book_snapshot_t const& book, std::ostream& os);
+bool is_jbook (std::string const& file);
+/// Waits until no mapped_book of @p file is left, at most @p timeout milliseconds, false if so
+bool wait_unmapped (std::string const& file, unsigned timeout);
 
 //--------------------------------------------------------------------------------------------------
 
@@ -148,15 +843,18 @@ extern bool obtain_image (std::string const& file, image_t& img);
 struct journal_t
 {
     bool show_titlebar;
+    bool edit_log;      ///< Save only the changes, into a log next to the book
+    bool freeze_variables;  ///< The placeholders are replaced by their outputs when saving
     std::string background_file;
     ID3D11ShaderResourceView* background;
 
     font_t button_font, chapter_font, text_font, default_font;
 
     button_t button_prev, button_next,
-             button_settings, button_elements, button_chapters,
+             button_settings, button_elements, button_chapters, button_search,
              button_save, button_saveas, button_load;
-    bool show_settings, show_elements, show_chapters, show_saveas, show_load;
+    bool show_settings, show_elements, show_chapters, show_search, show_saveas, show_load,
+         show_profiler;
 
     std::vector<variable_t> variables;
 
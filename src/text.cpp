@@ -0,0 +1,293 @@
+/**
+ * @file text.cpp
+ * @brief Plain text utilities over the page contents
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Kept apart from the rendering, so these can be measured and reused without the UI.
+ */
+
+#include "sse-journal.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+
+//--------------------------------------------------------------------------------------------------
+
+std::string&
+page_text::own ()
+{
+    if (!buffer)
+        buffer = std::make_shared<std::string> ();
+    else if (buffer.use_count () > 1)
+        buffer = std::make_shared<std::string> (*buffer);   // with the spare room, as ImGui asked
+    else
+        // Only the render thread shares it, so one left means the snapshots are done reading it
+        std::atomic_thread_fence (std::memory_order_acquire);
+    return *buffer;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+page_text::assign (std::string_view s)
+{
+    if (buffer && buffer.use_count () == 1)
+        own ().assign (s);
+    else
+        buffer = std::make_shared<std::string> (s);
+    length = s.size ();
+}
+
+void
+page_text::assign (std::string&& s)
+{
+    buffer = std::make_shared<std::string> (std::move (s));
+    length = buffer->size ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+page_text::append (std::string_view s)
+{
+    std::string copy;
+    if (buffer && s.data () >= buffer->data () && s.data () < buffer->data () + buffer->size ())
+        s = copy.assign (s);    // about to be moved by the growth below
+
+    reserve (length + s.size ());
+    auto& b = *buffer;
+    std::copy (s.begin (), s.end (), b.begin () + length);
+    length += s.size ();
+    b[length] = '\0';
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// ImGui asks for the exact size it needs, so typing into a page would reallocate it on each
+/// keystroke without the 1.5x growth.
+
+void
+page_text::reserve (std::size_t n)
+{
+    auto& b = own ();
+    if (n > b.size ())
+        b.resize (std::max (n, b.size () + b.size () / 2 + 15));
+}
+
+void
+page_text::edited ()
+{
+    length = std::strlen (c_str ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+shared_text
+page_text::share () const
+{
+    return shared_text { buffer, view () };
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+visible_symbols (std::string_view s)
+{
+    return find_visible (s) != std::string_view::npos;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static inline bool
+is_space (char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+std::string
+greedy_word_wrap (std::string_view source, unsigned width)
+{
+    auto n = source.size ();
+    std::string out (source);
+
+    for (std::size_t i = 0; i < n; )
+    {
+        // skip to the end of the line, a new line starting in between restarts the count
+        auto line = i;
+        for (std::size_t left = width; left > 0; )
+        {
+            if (i == n)
+                return out;
+            auto nl = find_byte (source.substr (i, left), '\n');
+            if (nl == std::string_view::npos)
+            {
+                i = std::min (n, i + left);
+                break;
+            }
+            i += nl + 1;
+            line = i;
+            left = width - 1;
+        }
+        if (i == n)
+            break;
+
+        if (is_space (source[i]))
+            out[i++] = '\n';
+        // check for nearest whitespace back in the line
+        else for (auto k = i; k-- > line; )
+            if (is_space (source[k]))
+            {
+                out[k] = '\n';
+                i = k + 1;
+                break;
+            }
+    }
+    return out;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Next code point as ImGui decodes it: U+FFFD for broken or out of its range sequences
+
+static char32_t
+next_char (std::string_view s, std::size_t& i)
+{
+    auto c = std::uint8_t (s[i++]);
+    if (c < 0x80)
+        return c;
+    int n = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    if (!n || i + n > s.size ())
+        return 0xFFFD;
+    char32_t u = c & (0x3F >> n);
+    for (int k = 0; k < n; ++k)
+    {
+        auto b = std::uint8_t (s[i + k]);
+        if ((b & 0xC0) != 0x80)
+            return 0xFFFD;
+        u = (u << 6) | (b & 0x3F);
+    }
+    i += n;
+    return u > 0xFFFF ? 0xFFFD : u;
+}
+
+void
+layout_text (text_layout_t& layout, std::string_view text, ImFont const& font,
+        float size, float width)
+{
+    layout.starts.clear ();
+    layout.ends.clear ();
+    layout.font = &font;
+    layout.size = size;
+    layout.width = width;
+
+    auto const& advances = font.IndexAdvanceX;
+    float scale = size / font.FontSize;
+    std::size_t line = 0;
+    for (;;)
+    {
+        auto eol = find_byte (text.substr (line), '\n');
+        eol = eol == std::string_view::npos ? text.size () : line + eol;
+        // Glyphs are added while they start within the width, the clipping cuts the last one
+        float x = 0;
+        auto i = line;
+        while (i < eol && x < width)
+        {
+            auto c = next_char (text, i);
+            if (c == '\r')
+                continue;
+            x += scale * (c < char32_t (advances.Size) ? advances.Data[c] : font.FallbackAdvanceX);
+        }
+        layout.starts.push_back (std::uint32_t (line));
+        layout.ends.push_back (std::uint32_t (i));
+        if (eol == text.size ())
+            break;
+        line = eol + 1;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+replace_all (std::string& data, std::string const& search, std::string const& replace)
+{
+    std::size_t n = data.find (search);
+    while (n != std::string::npos)
+    {
+        data.replace (n, search.size (), replace);
+        n = data.find (search, n + replace.size ());
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+format_program::compile (std::string_view source, std::initializer_list<std::string_view> names)
+{
+    if (compiled && source == format)
+        return;
+    format = source;
+    steps.clear ();
+    compiled = true;
+
+    auto literal = [this] (std::size_t from, std::size_t to) {
+        if (to == from)
+            return;
+        // Merged with the previous literal, as unknown % sequences split them
+        if (!steps.empty () && steps.back ().substitution < 0
+                && steps.back ().offset + steps.back ().size == from)
+            steps.back ().size += std::uint32_t (to - from);
+        else
+            steps.push_back (step_t { std::uint32_t (from), std::uint32_t (to - from), -1 });
+    };
+
+    std::size_t start = 0;
+    for (auto pos = format.find ('%'); pos != std::string::npos; pos = format.find ('%', pos))
+    {
+        auto rest = std::string_view (format).substr (pos + 1);
+        int match = -1;
+        std::size_t length = 0;
+        int index = 0;
+        for (auto name: names)
+        {
+            if (name.size () > length && rest.starts_with (name))
+            {
+                match = index;
+                length = name.size ();
+            }
+            ++index;
+        }
+        if (match < 0)
+        {
+            ++pos;
+            continue;
+        }
+        literal (start, pos);
+        steps.push_back (step_t { 0, 0, match });
+        start = pos = pos + 1 + length;
+    }
+    literal (start, format.size ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,629 @@
+/**
+ * @file textscan.cpp
+ * @brief Vectorized scanning of the page texts
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each kernel comes as plain C++, and for x86 as SSE2 (the x86-64 baseline) and AVX2 ones. The
+ * AVX2 ones are compiled for that target only by function attributes, so the rest of the binary
+ * still runs on any CPU, and are picked on the first use if the CPU has them.
+ *
+ * The substring search compares the first and the last byte of the searched word at 16 or 32
+ * positions at once, and only where both match compares the rest. UTF-8 validation is done on
+ * whole blocks only with AVX2, as SSE2 has no byte shuffles, the others skip the ASCII runs and
+ * check the rest byte by byte.
+ */
+
+#include "sse-journal.hpp"
+
+#include <cstring>
+#include <array>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#  define JOURNAL_X86_KERNELS 1
+#  include <immintrin.h>
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+/// All return @p n when there is nothing found
+struct text_kernels_t
+{
+    const char* name;
+    std::size_t (*find_byte) (const char* s, std::size_t n, char c);
+    std::size_t (*find_visible) (const char* s, std::size_t n);
+    std::size_t (*find_non_ascii) (const char* s, std::size_t n);
+    std::size_t (*count_byte) (const char* s, std::size_t n, char c);
+    std::size_t (*find_text) (const char* s, std::size_t n, const char* w, std::size_t m);
+    std::size_t (*find_folded) (const char* s, std::size_t n, const char* w, std::size_t m);
+    bool (*valid_utf8) (const char* s, std::size_t n);
+};
+
+static inline bool
+is_visible (char c)
+{
+    auto b = std::uint8_t (c);
+    return b > ' ' && b != 0x7F;
+}
+
+static inline char
+fold_ascii (char c)
+{
+    return c >= 'A' && c <= 'Z' ? char (c - 'A' + 'a') : c;
+}
+
+static inline bool
+same_folded (const char* a, const char* b, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+        if (fold_ascii (a[i]) != fold_ascii (b[i]))
+            return false;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static std::size_t
+find_byte_scalar (const char* s, std::size_t n, char c)
+{
+    auto p = static_cast<const char*> (std::memchr (s, c, n));
+    return p ? std::size_t (p - s) : n;
+}
+
+static std::size_t
+find_visible_scalar (const char* s, std::size_t n)
+{
+    std::size_t i = 0;
+    while (i < n && !is_visible (s[i]))
+        ++i;
+    return i;
+}
+
+static std::size_t
+find_non_ascii_scalar (const char* s, std::size_t n)
+{
+    std::size_t i = 0;
+    while (i < n && !(s[i] & 0x80))
+        ++i;
+    return i;
+}
+
+static std::size_t
+count_byte_scalar (const char* s, std::size_t n, char c)
+{
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        k += s[i] == c;
+    return k;
+}
+
+static std::size_t
+find_text_scalar (const char* s, std::size_t n, const char* w, std::size_t m)
+{
+    auto i = std::string_view (s, n).find (std::string_view (w, m));
+    return i == std::string_view::npos ? n : i;
+}
+
+static std::size_t
+find_folded_scalar (const char* s, std::size_t n, const char* w, std::size_t m)
+{
+    for (std::size_t i = 0; i + m <= n; ++i)
+        if (same_folded (s + i, w, m))
+            return i;
+    return n;
+}
+
+/// Byte by byte, but for the ASCII runs which @p skip finds the end of
+
+static bool
+valid_utf8_skipping (const char* s, std::size_t n, std::size_t (*skip) (const char*, std::size_t))
+{
+    auto p = reinterpret_cast<const std::uint8_t*> (s);
+    std::size_t i = 0;
+    while (i < n)
+    {
+        i += skip (s + i, n - i);
+        if (i == n)
+            break;
+
+        auto b = p[i];
+        std::size_t len = b < 0xC2 ? 0 : b < 0xE0 ? 2 : b < 0xF0 ? 3 : b < 0xF5 ? 4 : 0;
+        if (!len || i + len > n)
+            return false;
+        for (std::size_t k = 1; k < len; ++k)
+            if ((p[i+k] & 0xC0) != 0x80)
+                return false;
+        // Overlong forms, surrogates and above U+10FFFF
+        auto c = p[i+1];
+        if ((b == 0xE0 && c < 0xA0) || (b == 0xED && c >= 0xA0)
+                || (b == 0xF0 && c < 0x90) || (b == 0xF4 && c >= 0x90))
+            return false;
+        i += len;
+    }
+    return true;
+}
+
+static bool
+valid_utf8_scalar (const char* s, std::size_t n)
+{
+    return valid_utf8_skipping (s, n, find_non_ascii_scalar);
+}
+
+static const text_kernels_t scalar_kernels = {
+    "scalar",
+    find_byte_scalar, find_visible_scalar, find_non_ascii_scalar, count_byte_scalar,
+    find_text_scalar, find_folded_scalar, valid_utf8_scalar
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#ifdef JOURNAL_X86_KERNELS
+
+static inline __m128i
+fold_sse2 (__m128i v)
+{
+    auto upper = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('A' - 1)),
+                                _mm_cmplt_epi8 (v, _mm_set1_epi8 ('Z' + 1)));
+    return _mm_add_epi8 (v, _mm_and_si128 (upper, _mm_set1_epi8 (0x20)));
+}
+
+static std::size_t
+find_byte_sse2 (const char* s, std::size_t n, char c)
+{
+    auto needle = _mm_set1_epi8 (c);
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        auto v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s + i));
+        if (unsigned mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, needle)))
+            return i + __builtin_ctz (mask);
+    }
+    return i + find_byte_scalar (s + i, n - i, c);
+}
+
+static std::size_t
+find_visible_sse2 (const char* s, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        auto v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s + i));
+        // Signed: the UTF-8 bytes are negative, hence visible
+        auto hidden = _mm_or_si128 (
+                _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 (-1)),
+                               _mm_cmplt_epi8 (v, _mm_set1_epi8 (' ' + 1))),
+                _mm_cmpeq_epi8 (v, _mm_set1_epi8 (0x7F)));
+        if (unsigned mask = ~_mm_movemask_epi8 (hidden) & 0xFFFFu)
+            return i + __builtin_ctz (mask);
+    }
+    return i + find_visible_scalar (s + i, n - i);
+}
+
+static std::size_t
+find_non_ascii_sse2 (const char* s, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        auto v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s + i));
+        if (unsigned mask = _mm_movemask_epi8 (v))
+            return i + __builtin_ctz (mask);
+    }
+    return i + find_non_ascii_scalar (s + i, n - i);
+}
+
+/// Counted per byte lane, summed up before any lane overflows
+
+static std::size_t
+count_byte_sse2 (const char* s, std::size_t n, char c)
+{
+    auto needle = _mm_set1_epi8 (c), zero = _mm_setzero_si128 (), total = zero;
+    std::size_t i = 0;
+    while (i + 16 <= n)
+    {
+        auto lanes = zero;
+        for (int k = 0; k < 255 && i + 16 <= n; ++k, i += 16)
+        {
+            auto v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s + i));
+            lanes = _mm_sub_epi8 (lanes, _mm_cmpeq_epi8 (v, needle));
+        }
+        total = _mm_add_epi64 (total, _mm_sad_epu8 (lanes, zero));
+    }
+    alignas (16) std::uint64_t sums[2];
+    _mm_store_si128 (reinterpret_cast<__m128i*> (sums), total);
+    return std::size_t (sums[0] + sums[1]) + count_byte_scalar (s + i, n - i, c);
+}
+
+template<bool Folded>
+static std::size_t
+find_text_sse2 (const char* s, std::size_t n, const char* w, std::size_t m)
+{
+    if (m > n)
+        return n;
+    if (!m)
+        return 0;
+    auto first = _mm_set1_epi8 (Folded ? fold_ascii (w[0]) : w[0]);
+    auto last = _mm_set1_epi8 (Folded ? fold_ascii (w[m-1]) : w[m-1]);
+
+    std::size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16)
+    {
+        auto b = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s + i));
+        auto e = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s + i + m - 1));
+        if constexpr (Folded)
+            b = fold_sse2 (b), e = fold_sse2 (e);
+        unsigned mask = _mm_movemask_epi8 (
+                _mm_and_si128 (_mm_cmpeq_epi8 (b, first), _mm_cmpeq_epi8 (e, last)));
+        for (; mask; mask &= mask - 1)
+        {
+            auto at = i + __builtin_ctz (mask);
+            if (Folded ? same_folded (s + at + 1, w + 1, m - 1)
+                       : !std::memcmp (s + at + 1, w + 1, m - 1))
+                return at;
+        }
+    }
+    return i + (Folded ? find_folded_scalar : find_text_scalar) (s + i, n - i, w, m);
+}
+
+static bool
+valid_utf8_sse2 (const char* s, std::size_t n)
+{
+    return valid_utf8_skipping (s, n, find_non_ascii_sse2);
+}
+
+static const text_kernels_t sse2_kernels = {
+    "sse2",
+    find_byte_sse2, find_visible_sse2, find_non_ascii_sse2, count_byte_sse2,
+    find_text_sse2<false>, find_text_sse2<true>, valid_utf8_sse2
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#define JOURNAL_AVX2 __attribute__ ((target ("avx2")))
+
+JOURNAL_AVX2 static inline __m256i
+fold_avx2 (__m256i v)
+{
+    auto upper = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 ('A' - 1)),
+                                   _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('Z' + 1), v));
+    return _mm256_add_epi8 (v, _mm256_and_si256 (upper, _mm256_set1_epi8 (0x20)));
+}
+
+JOURNAL_AVX2 static std::size_t
+find_byte_avx2 (const char* s, std::size_t n, char c)
+{
+    auto needle = _mm256_set1_epi8 (c);
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        auto v = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (s + i));
+        if (unsigned mask = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, needle)))
+            return i + __builtin_ctz (mask);
+    }
+    return i + find_byte_sse2 (s + i, n - i, c);
+}
+
+JOURNAL_AVX2 static std::size_t
+find_visible_avx2 (const char* s, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        auto v = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (s + i));
+        auto hidden = _mm256_or_si256 (
+                _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 (-1)),
+                                  _mm256_cmpgt_epi8 (_mm256_set1_epi8 (' ' + 1), v)),
+                _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (0x7F)));
+        if (unsigned mask = ~unsigned (_mm256_movemask_epi8 (hidden)))
+            return i + __builtin_ctz (mask);
+    }
+    return i + find_visible_sse2 (s + i, n - i);
+}
+
+JOURNAL_AVX2 static std::size_t
+find_non_ascii_avx2 (const char* s, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        auto v = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (s + i));
+        if (unsigned mask = _mm256_movemask_epi8 (v))
+            return i + __builtin_ctz (mask);
+    }
+    return i + find_non_ascii_sse2 (s + i, n - i);
+}
+
+JOURNAL_AVX2 static std::size_t
+count_byte_avx2 (const char* s, std::size_t n, char c)
+{
+    auto needle = _mm256_set1_epi8 (c), zero = _mm256_setzero_si256 (), total = zero;
+    std::size_t i = 0;
+    while (i + 32 <= n)
+    {
+        auto lanes = zero;
+        for (int k = 0; k < 255 && i + 32 <= n; ++k, i += 32)
+        {
+            auto v = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (s + i));
+            lanes = _mm256_sub_epi8 (lanes, _mm256_cmpeq_epi8 (v, needle));
+        }
+        total = _mm256_add_epi64 (total, _mm256_sad_epu8 (lanes, zero));
+    }
+    alignas (32) std::uint64_t sums[4];
+    _mm256_store_si256 (reinterpret_cast<__m256i*> (sums), total);
+    return std::size_t (sums[0] + sums[1] + sums[2] + sums[3]) + count_byte_sse2 (s + i, n - i, c);
+}
+
+template<bool Folded>
+JOURNAL_AVX2 static std::size_t
+find_text_avx2 (const char* s, std::size_t n, const char* w, std::size_t m)
+{
+    if (m > n)
+        return n;
+    if (!m)
+        return 0;
+    auto first = _mm256_set1_epi8 (Folded ? fold_ascii (w[0]) : w[0]);
+    auto last = _mm256_set1_epi8 (Folded ? fold_ascii (w[m-1]) : w[m-1]);
+
+    std::size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32)
+    {
+        auto b = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (s + i));
+        auto e = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (s + i + m - 1));
+        if constexpr (Folded)
+            b = fold_avx2 (b), e = fold_avx2 (e);
+        unsigned mask = _mm256_movemask_epi8 (
+                _mm256_and_si256 (_mm256_cmpeq_epi8 (b, first), _mm256_cmpeq_epi8 (e, last)));
+        for (; mask; mask &= mask - 1)
+        {
+            auto at = i + __builtin_ctz (mask);
+            if (Folded ? same_folded (s + at + 1, w + 1, m - 1)
+                       : !std::memcmp (s + at + 1, w + 1, m - 1))
+                return at;
+        }
+    }
+    return i + find_text_sse2<Folded> (s + i, n - i, w, m);
+}
+
+/**
+ * Validates 32 bytes at once, by classifying each byte together with the one before it through
+ * three 16 entry tables, as in "Validating UTF-8 In Less Than One Instruction Per Byte" (Keiser,
+ * Lemire, 2021). The 3rd and 4th bytes of the longer sequences are checked apart.
+ */
+
+JOURNAL_AVX2 static inline __m256i
+utf8_prev (__m256i input, __m256i prev_input, int n)
+{
+    auto joined = _mm256_permute2x128_si256 (prev_input, input, 0x21);
+    switch (n)
+    {
+        case 1: return _mm256_alignr_epi8 (input, joined, 15);
+        case 2: return _mm256_alignr_epi8 (input, joined, 14);
+        default: return _mm256_alignr_epi8 (input, joined, 13);
+    }
+}
+
+JOURNAL_AVX2 static inline __m256i
+utf8_lookup (__m256i nibbles, std::array<std::uint8_t, 16> const& t)
+{
+    auto table = _mm256_broadcastsi128_si256 (
+            _mm_loadu_si128 (reinterpret_cast<const __m128i*> (t.data ())));
+    return _mm256_shuffle_epi8 (table, nibbles);
+}
+
+JOURNAL_AVX2 static inline __m256i
+utf8_errors (__m256i input, __m256i prev_input)
+{
+    constexpr std::uint8_t too_short = 1<<0, too_long = 1<<1, overlong_3 = 1<<2, too_large = 1<<3,
+        surrogate = 1<<4, overlong_2 = 1<<5, too_large_1000 = 1<<6, overlong_4 = 1<<6,
+        two_conts = 1<<7, carry = too_short | too_long | two_conts,
+        large = carry | too_large | too_large_1000, cont = too_long | overlong_2 | two_conts;
+
+    static const std::array<std::uint8_t, 16> byte_1_high = {{
+        too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+        two_conts, two_conts, two_conts, two_conts,
+        too_short | overlong_2, too_short, too_short | overlong_3 | surrogate,
+        too_short | too_large | too_large_1000 | overlong_4 }};
+    static const std::array<std::uint8_t, 16> byte_1_low = {{
+        carry | overlong_3 | overlong_2 | overlong_4, carry | overlong_2, carry, carry,
+        carry | too_large, large, large, large,
+        large, large, large, large, large, large | surrogate, large, large }};
+    static const std::array<std::uint8_t, 16> byte_2_high = {{
+        too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+        cont | overlong_3 | too_large_1000 | overlong_4, cont | overlong_3 | too_large,
+        cont | surrogate | too_large, cont | surrogate | too_large,
+        too_short, too_short, too_short, too_short }};
+
+    auto low = _mm256_set1_epi8 (0x0F);
+    auto prev1 = utf8_prev (input, prev_input, 1);
+    auto special = _mm256_and_si256 (_mm256_and_si256 (
+            utf8_lookup (_mm256_and_si256 (_mm256_srli_epi16 (prev1, 4), low), byte_1_high),
+            utf8_lookup (_mm256_and_si256 (prev1, low), byte_1_low)),
+            utf8_lookup (_mm256_and_si256 (_mm256_srli_epi16 (input, 4), low), byte_2_high));
+
+    // Only 111_____ and 1111____ leads stay above zero
+    auto third = _mm256_subs_epu8 (utf8_prev (input, prev_input, 2), _mm256_set1_epi8 (char (0xE0 - 1)));
+    auto fourth = _mm256_subs_epu8 (utf8_prev (input, prev_input, 3), _mm256_set1_epi8 (char (0xF0 - 1)));
+    auto must23 = _mm256_cmpgt_epi8 (_mm256_or_si256 (third, fourth), _mm256_setzero_si256 ());
+    return _mm256_xor_si256 (_mm256_and_si256 (must23, _mm256_set1_epi8 (char (0x80))), special);
+}
+
+struct utf8_state_t
+{
+    __m256i error, prev_input, prev_incomplete;
+};
+
+JOURNAL_AVX2 static inline void
+utf8_block (utf8_state_t& st, __m256i input)
+{
+    // Nonzero where the last bytes of a block start a sequence, which must go on in the next one
+    auto const max_value = _mm256_setr_epi8 (
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            char (0xF0 - 1), char (0xE0 - 1), char (0xC0 - 1));
+
+    if (!_mm256_movemask_epi8 (input))
+        st.error = _mm256_or_si256 (st.error, st.prev_incomplete);
+    else
+    {
+        st.error = _mm256_or_si256 (st.error, utf8_errors (input, st.prev_input));
+        st.prev_incomplete = _mm256_subs_epu8 (input, max_value);
+        st.prev_input = input;
+    }
+}
+
+JOURNAL_AVX2 static bool
+valid_utf8_avx2 (const char* s, std::size_t n)
+{
+    auto zero = _mm256_setzero_si256 ();
+    utf8_state_t st { zero, zero, zero };
+
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+        utf8_block (st, _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (s + i)));
+    // Zero padded, so a sequence cut by the end shows as too short
+    alignas (32) char tail[32] = {};
+    std::memcpy (tail, s + i, n - i);
+    utf8_block (st, _mm256_load_si256 (reinterpret_cast<const __m256i*> (tail)));
+    return _mm256_testz_si256 (st.error, st.error);
+}
+
+static const text_kernels_t avx2_kernels = {
+    "avx2",
+    find_byte_avx2, find_visible_avx2, find_non_ascii_avx2, count_byte_avx2,
+    find_text_avx2<false>, find_text_avx2<true>, valid_utf8_avx2
+};
+
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+static bool
+cpu_has (std::string_view name)
+{
+    if (name == "scalar")
+        return true;
+#ifdef JOURNAL_X86_KERNELS
+    __builtin_cpu_init ();
+    if (name == "sse2")
+        return true;
+    if (name == "avx2")
+        return __builtin_cpu_supports ("avx2");
+#endif
+    return false;
+}
+
+static const text_kernels_t*
+kernels_named (std::string_view name)
+{
+#ifdef JOURNAL_X86_KERNELS
+    if (name == "avx2") return &avx2_kernels;
+    if (name == "sse2") return &sse2_kernels;
+#endif
+    return &scalar_kernels;
+}
+
+static const text_kernels_t*
+best_kernels ()
+{
+    for (auto name: { "avx2", "sse2" })
+        if (cpu_has (name))
+            return kernels_named (name);
+    return &scalar_kernels;
+}
+
+/// Picked once, though the bench switches between them
+static const text_kernels_t* kernels = best_kernels ();
+
+//--------------------------------------------------------------------------------------------------
+
+const char*
+text_kernels ()
+{
+    return kernels->name;
+}
+
+bool
+use_text_kernels (std::string_view name)
+{
+    if (!name.empty () && !cpu_has (name))
+        return false;
+    kernels = name.empty () ? best_kernels () : kernels_named (name);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static inline std::size_t
+npos_if_end (std::size_t i, std::size_t n)
+{
+    return i < n ? i : std::string_view::npos;
+}
+
+std::size_t
+find_byte (std::string_view s, char c)
+{
+    return npos_if_end (kernels->find_byte (s.data (), s.size (), c), s.size ());
+}
+
+std::size_t
+find_visible (std::string_view s)
+{
+    return npos_if_end (kernels->find_visible (s.data (), s.size ()), s.size ());
+}
+
+std::size_t
+count_newlines (std::string_view s)
+{
+    return kernels->count_byte (s.data (), s.size (), '\n');
+}
+
+std::size_t
+find_text (std::string_view text, std::string_view word, std::size_t from)
+{
+    if (from > text.size ())
+        return std::string_view::npos;
+    auto n = text.size () - from;
+    auto i = kernels->find_text (text.data () + from, n, word.data (), word.size ());
+    // An empty word is found right there, even at the end
+    return i < n || word.empty () ? from + i : std::string_view::npos;
+}
+
+std::size_t
+find_folded (std::string_view text, std::string_view word, std::size_t from)
+{
+    if (from > text.size ())
+        return std::string_view::npos;
+    auto n = text.size () - from;
+    auto i = kernels->find_folded (text.data () + from, n, word.data (), word.size ());
+    return i < n || word.empty () ? from + i : std::string_view::npos;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+bool
+valid_utf8 (std::string_view s)
+{
+    return kernels->valid_utf8 (s.data (), s.size ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,176 @@
+/**
+ * @file trace.cpp
+ * @brief Timeline of the loading, saving and rendering spans, written as a Chrome trace file
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The spans are those of the profile_scope objects, on any thread, each recorded once it ends as
+ * a "complete" event: its begin and its duration. The file is in the Trace Event Format, which
+ * chrome://tracing and https://ui.perfetto.dev open.
+ *
+ * Disabled, recording costs a relaxed atomic load. Enabled, a lock per span, which is fine for
+ * the few dozens a frame. Past #max_events nothing more is kept, until the next enabling.
+ */
+
+#include "sse-journal.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+//--------------------------------------------------------------------------------------------------
+
+using trace_clock = std::chrono::steady_clock;
+
+/// Some minutes of rendering, about 20 MB
+constexpr std::size_t max_events = 1 << 18;
+
+struct trace_event_t
+{
+    const char* name;
+    std::uint32_t thread;
+    std::int64_t begin, end;    ///< Clock ticks since the tracing started
+    std::uint32_t count;        ///< Used args
+    std::array<trace_arg_t, 2> args;
+};
+
+static std::atomic<bool> enabled { false };
+static std::mutex lock;
+static std::vector<trace_event_t> events;
+static std::size_t dropped = 0;
+static trace_clock::time_point epoch;
+
+/// Small numbers for the threads, in order of their first span
+static std::atomic<std::uint32_t> threads { 0 };
+
+//--------------------------------------------------------------------------------------------------
+
+void
+enable_tracing (bool on)
+{
+    std::lock_guard<std::mutex> guard (lock);
+    if (on && !enabled.load (std::memory_order_relaxed))
+    {
+        events.clear ();
+        dropped = 0;
+        epoch = trace_clock::now ();
+    }
+    enabled.store (on, std::memory_order_relaxed);
+}
+
+bool
+tracing_enabled ()
+{
+    return enabled.load (std::memory_order_relaxed);
+}
+
+std::size_t
+traced_events ()
+{
+    std::lock_guard<std::mutex> guard (lock);
+    return events.size ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+trace_span (const char* name, std::int64_t begin, std::int64_t end,
+            trace_arg_t const* args, std::size_t count)
+{
+    thread_local std::uint32_t thread = ++threads;
+
+    std::lock_guard<std::mutex> guard (lock);
+    if (!enabled.load (std::memory_order_relaxed))
+        return;
+    if (events.size () == max_events)
+    {
+        ++dropped;
+        return;
+    }
+    auto since = epoch.time_since_epoch ().count ();
+    trace_event_t e { name, thread, begin - since, end - since, 0, {} };
+    for (; e.count < count && e.count < e.args.size (); ++e.count)
+        e.args[e.count] = args[e.count];
+    events.push_back (e);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Microseconds, as the format wants them, keeping the nanoseconds as decimals
+
+static void
+write_microseconds (std::ostream& os, std::int64_t ticks)
+{
+    auto ns = std::max<std::int64_t> (0, std::chrono::duration_cast<std::chrono::nanoseconds> (
+                trace_clock::duration (ticks)).count ());
+    os << ns / 1000 << '.' << char ('0' + ns / 100 % 10) << char ('0' + ns / 10 % 10)
+       << char ('0' + ns % 10);
+}
+
+bool
+write_trace (std::string const& file)
+{
+    std::vector<trace_event_t> copy;
+    std::size_t lost;
+    {
+        std::lock_guard<std::mutex> guard (lock);
+        copy = events;
+        lost = dropped;
+    }
+
+    std::ofstream of (file);
+    if (!of.is_open ())
+    {
+        log (log_level::error) << "Unable to open " << file << " for writting." << std::endl;
+        return false;
+    }
+
+    // The names are identifiers from the source, nothing to escape
+    of << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":" << lost
+       << "},\"traceEvents\":[\n";
+    for (std::size_t i = 0; i < copy.size (); ++i)
+    {
+        auto const& e = copy[i];
+        of << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+           << ",\"ts\":";
+        write_microseconds (of, e.begin);
+        of << ",\"dur\":";
+        write_microseconds (of, e.end - e.begin);
+        of << ",\"args\":{";
+        for (std::uint32_t a = 0; a < e.count; ++a)
+            of << (a ? "," : "") << '"' << e.args[a].name << "\":" << e.args[a].value;
+        of << "}}" << (i + 1 < copy.size () ? ",\n" : "\n");
+    }
+    of << "]}\n";
+
+    of.close ();
+    if (!of)
+    {
+        log (log_level::error) << "Unable to write " << file << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
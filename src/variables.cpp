@@ -33,8 +33,6 @@
 #include <string>
 #include <functional>
 #include <ctime>
-#include <cmath>
-#include <algorithm>
 
 #include <windows.h>
 
@@ -43,26 +41,6 @@
 /// Defined in skse.cpp
 extern sseh_api sseh;
 
-/// To turn relative addresses into absolute so that the Skyrim watch points can be set.
-static std::uintptr_t skyrim_base = 0;
-
-/// Obtains an address to a relative object, to a relative object, to a relative object, to a...
-template<class T, unsigned N = 1>
-struct relocation
-{
-    std::array<std::uintptr_t, 1+N> offsets;
-    T obtain () const
-    {
-        std::uintptr_t that = skyrim_base;
-        for (unsigned i = 0; i < N; ++i)
-        {
-            that = *reinterpret_cast<std::uintptr_t*> (that + offsets[i]);
-            if (!that) return nullptr;
-        }
-        return reinterpret_cast<T> (that + offsets[N]);
-    }
-};
-
 /**
  * Current in-game time since...
  *
@@ -90,7 +68,7 @@ struct relocation
  * *0x1ec3bc8 +  0x34
  */
 
-struct relocation<float*> game_epoch { 0x1ec3bc8, 0x34 };
+static const relocation<float*> game_epoch { 0x1ec3bc8, 0x34 };
 
 /**
  * Player position as 3 xyz floats.
@@ -103,11 +81,11 @@ struct relocation<float*> game_epoch { 0x1ec3bc8, 0x34 };
  * in your journal from first person point of view.
  */
 
-struct relocation<float*> player_pos { 0x2f26ef8, 0x54 };
+static const relocation<float*> player_pos { 0x2f26ef8, 0x54 };
 
 /// Better source of names for location - good addition to the World space name.
 
-struct relocation<const char*, 3> player_cell { 0x2f26ef8, 0x60, 0x28, 0 };
+static const relocation<const char*, 3> player_cell { 0x2f26ef8, 0x60, 0x28, 0 };
 
 /**
  * Current worldspace pointer from the PlayerCharacter class accroding to SKSE.
@@ -116,196 +94,37 @@ struct relocation<const char*, 3> player_cell { 0x2f26ef8, 0x60, 0x28, 0 };
  * during Main Menu, and likely in some locations like the Alternate Start room.
  */
 
-struct relocation<const char*, 3> worldspace_name { 0x2f26ef8, 0x628, 0x28, 0x00 };
-
-//--------------------------------------------------------------------------------------------------
-
-/// Small utility function
-static void
-replace_all (std::string& data, std::string const& search, std::string const& replace)
-{
-    std::size_t n = data.find (search);
-    while (n != std::string::npos)
-    {
-        data.replace (n, search.size (), replace);
-        n = data.find (search, n + replace.size ());
-    }
-}
-
-//--------------------------------------------------------------------------------------------------
-
-/// It is too easy to crash, of the format is freely adjusted by the user
-
-static std::string
-player_location (std::string format)
-{
-    float* pos = player_pos.obtain ();
-    if (!pos || !std::isfinite (pos[0]) || !std::isfinite (pos[1]) || !std::isfinite (pos[2]))
-        return "(n/a)";
-
-    std::array<std::string, 3> sp;
-    for (int i = 0; i < 3; ++i)
-    {
-        sp[i].resize (15);
-        sp[i].resize (std::snprintf (&sp[i][0], sp[i].size (), "%.0f", pos[i]));
-    }
-
-    replace_all (format, "%x", sp[0]);
-    replace_all (format, "%y", sp[1]);
-    replace_all (format, "%z", sp[2]);
-
-    replace_all (format, "%cx", std::to_string (int (std::floor (pos[0]/4096))));
-    replace_all (format, "%cy", std::to_string (int (std::floor (pos[1]/4096))));
-
-    if (auto name = worldspace_name.obtain ())
-         replace_all (format, "%wn", name);
-    else replace_all (format, "%wn", "");
-
-    if (auto name = player_cell.obtain ())
-         replace_all (format, "%cn", name);
-    else replace_all (format, "%cn", "");
-
-    return format;
-}
-
-//--------------------------------------------------------------------------------------------------
-
-static std::string
-local_time (const char* format, std::tm& lt)
-{
-    std::string s;
-    std::size_t n = 16;
-    do
-    {
-        s.resize (n-1);
-        if (auto r = std::strftime (&s[0], n-1, format, &lt))
-        {
-            s.resize (r);
-            break;
-        }
-        n *= 2;
-    }
-    while (n < 512);
-    return s;
-}
-
-//--------------------------------------------------------------------------------------------------
-
-/**
- * Very simple custom formatted time printing for the Skyrim calendar.
- *
- * Preparses some stuff before calling back strftime()
- */
-
-static std::string
-game_time (std::string format)
-{
-    float* source = game_epoch.obtain ();
-    if (!source || !std::isnormal (*source) || *source < 0)
-        return "(n/a)";
-
-    // Compute the format input
-    float hms = *source - int (*source);
-    int h = int (hms *= 24);
-    hms  -= int (hms);
-    int m = int (hms *= 60);
-    hms  -= int (hms);
-    int s = int (hms * 60);
-
-    // Adjusts for starting date: Sun, 17 Jul 201 (considering that the year starts Wed)
-    int d = int (*source) + 228;
-    int y = d / 365 + 201;
-    int yd = d % 365 + 1;
-    int wd = (d+3) % 7;
-
-    std::array<int, 12> months = { 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365 };
-    auto mit = std::lower_bound (months.cbegin (), months.cend (), yd);
-    int mo = mit - months.cbegin ();
-    int md = (mo ? yd-*(mit-1) : yd);
-
-    // Replace years
-    auto sy = std::to_string (y);
-    auto sY = "4E" + sy;
-    replace_all (format, "%y", sy);
-    replace_all (format, "%Y", sY);
-
-    // Replace months
-    static std::array<std::string, 12> longmon = {
-        "Morning Star", "Sun's Dawn", "First Seed", "Rain's Hand", "Second Seed", "Midyear",
-        "Sun's Height", "Last Seed", "Hearthfire", "Frostfall", "Sun's Dusk", "Evening Star"
-    };
-    static std::array<std::string, 12> birtmon = {
-        "The Ritual", "The Lover", "The Lord", "The Mage", "The Shadow", "The Steed",
-        "The Apprentice", "The Warrior", "The Lady", "The Tower", "The Atronach", "The Thief"
-    };
-    static std::array<std::string, 12> argomon = {
-        "Vakka (Sun)", "Xeech (Nut)", "Sisei (Sprout)", "Hist-Deek (Hist Sapling)",
-        "Hist-Dooka (Mature Hist)", "Hist-Tsoko (Elder Hist)", "Thtithil-Gah (Egg-Basket)",
-        "Thtithil (Egg)", "Nushmeeko (Lizard)", "Shaja-Nushmeeko (Semi-Humanoid Lizard)",
-        "Saxhleel (Argonian)", "Xulomaht (The Deceased)"
-    };
-    replace_all (format, "%lm", longmon[mo]);
-    replace_all (format, "%bm", birtmon[mo]);
-    replace_all (format, "%am", argomon[mo]);
-    replace_all (format, "%mo", std::to_string (mo+1));
-    replace_all (format, "%md", std::to_string (md));
-
-    // Weekdays
-    static std::array<std::string, 7> longwday = {
-        "Sundas", "Morndas", "Tirdas", "Middas", "Turdas", "Fredas", "Loredas"
-    };
-    static std::array<std::string, 7> shrtwday = {
-        "Sun", "Mor", "Tir", "Mid", "Tur", "Fre", "Lor"
-    };
-    replace_all (format, "%sd", shrtwday[wd]);
-    replace_all (format, "%ld", longwday[wd]);
-    replace_all (format, "%wd", std::to_string (wd+1));
-
-    // Time
-    replace_all (format, "%h", std::to_string (h));
-    replace_all (format, "%m", std::to_string (m));
-    replace_all (format, "%s", std::to_string (s));
-
-    // Raw
-    replace_all (format, "%ri", std::to_string (d));
-    replace_all (format, "%r", std::to_string (*source));
-
-    return format;
-}
-
-//--------------------------------------------------------------------------------------------------
-
-std::string
-local_time (const char* format)
-{
-    std::time_t t = std::time (nullptr);
-    std::tm* lt = std::localtime (&t);
-    return local_time (format, *lt);
-}
+static const relocation<const char*, 3> worldspace_name { 0x2f26ef8, 0x628, 0x28, 0x00 };
 
 //--------------------------------------------------------------------------------------------------
 
 std::vector<variable_t>
 make_variables ()
 {
-    skyrim_base = reinterpret_cast<std::uintptr_t> (::GetModuleHandle (nullptr));
+    // To turn relative addresses into absolute so that the Skyrim watch points can be set.
+    auto& gm = game_memory;
+    gm.base = reinterpret_cast<std::uintptr_t> (::GetModuleHandle (nullptr));
+    gm.epoch = game_epoch;
+    gm.position = player_pos;
+    gm.cell = player_cell;
+    gm.worldspace = worldspace_name;
     std::vector<variable_t> vars;
 
     if (sseh.find_target)
     {
-        sseh.find_target ("GameTime", &game_epoch.offsets[0]);
-        sseh.find_target ("GameTime.Offset", &game_epoch.offsets[1]);
-        sseh.find_target ("PlayerCharacter", &player_pos.offsets[0]);
-        sseh.find_target ("PlayerCharacter.Position", &player_pos.offsets[1]);
-        sseh.find_target ("PlayerCharacter.Cell", &player_cell.offsets[1]);
-        sseh.find_target ("PlayerCharacter.Worldspace", &worldspace_name.offsets[1]);
-        sseh.find_target ("Worldspace.Fullname", &worldspace_name.offsets[2]);
-        sseh.find_target ("Cell.Fullname", &player_cell.offsets[2]);
-        worldspace_name.offsets[0] = player_pos.offsets[0];
-        player_cell.offsets[0] = player_pos.offsets[0];
+        sseh.find_target ("GameTime", &gm.epoch.offsets[0]);
+        sseh.find_target ("GameTime.Offset", &gm.epoch.offsets[1]);
+        sseh.find_target ("PlayerCharacter", &gm.position.offsets[0]);
+        sseh.find_target ("PlayerCharacter.Position", &gm.position.offsets[1]);
+        sseh.find_target ("PlayerCharacter.Cell", &gm.cell.offsets[1]);
+        sseh.find_target ("PlayerCharacter.Worldspace", &gm.worldspace.offsets[1]);
+        sseh.find_target ("Worldspace.Fullname", &gm.worldspace.offsets[2]);
+        sseh.find_target ("Cell.Fullname", &gm.cell.offsets[2]);
+        gm.worldspace.offsets[0] = gm.position.offsets[0];
+        gm.cell.offsets[0] = gm.position.offsets[0];
     }
 
-    if (game_epoch.offsets[0])
+    if (gm.epoch.offsets[0])
     {
         variable_t gtime;
         gtime.fuid = 1;
@@ -328,10 +147,24 @@ make_variables ()
             "r is the raw input (aka Papyrus.GetCurrentGameTime ())\n"
             "ri is the integer part of %r (i.e. game days since start)";
         gtime.params = "%h:%m %ld, day %md of %lm, %Y";
-        gtime.apply = [] (variable_t* self) { return game_time (self->params); };
+        gtime.apply = [] (variable_t* self) {
+            auto const& gs = game_state ();
+            if (!gs.has_epoch)
+            {
+                self->output = "(n/a)";
+                return;
+            }
+            compile_game_time (self->program, self->params);
+            game_time (self->output, self->program, gs.epoch);
+        };
+        gtime.inputs = [] (variable_t* self, std::string& key) {
+            auto const& gs = game_state ();
+            compile_game_time (self->program, self->params);
+            game_time_inputs (key, self->program, gs.has_epoch ? gs.epoch : -1.f);
+        };
         vars.emplace_back (std::move (gtime));
     }
-    if (player_pos.offsets[0])
+    if (gm.position.offsets[0])
     {
         variable_t ppos;
         ppos.fuid = 3;
@@ -344,7 +177,13 @@ make_variables ()
             "%cn current cell name, if any\n"
             "%wn world space name if any";
         ppos.params = "%wn, %cn: %x %y %z";
-        ppos.apply = [] (variable_t* self) { return player_location (self->params); };
+        ppos.apply = [] (variable_t* self) {
+            compile_player_location (self->program, self->params);
+            player_location (self->output, self->program, game_state ());
+        };
+        ppos.inputs = [] (variable_t*, std::string& key) {
+            player_location_inputs (key, game_state ());
+        };
         vars.emplace_back (std::move (ppos));
     }
 
@@ -355,7 +194,11 @@ make_variables ()
     ltime.info = "Look the format specification on\n"
         "https://en.cppreference.com/w/cpp/chrono/c/strftime";
     ltime.params = "%X %x";
-    ltime.apply = [] (variable_t* self) { return local_time (self->params.c_str ()); };
+    ltime.apply = [] (variable_t* self) { self->output = local_time (self->params.c_str ()); };
+    ltime.inputs = [] (variable_t*, std::string& key) {
+        auto t = std::time (nullptr);
+        key.append (reinterpret_cast<const char*> (&t), sizeof (t));
+    };
     vars.emplace_back (std::move (ltime));
 
     return vars;
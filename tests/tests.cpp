@@ -0,0 +1,620 @@
+/**
+ * @file tests.cpp
+ * @brief Checks of what the journal core outputs, run by "waf build --run_tests"
+ * @internal
+ *
+ * This file is part of Skyrim SE Journal mod (aka Journal).
+ *
+ *   Journal is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Journal is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with Journal. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Builds
+ *
+ * @details
+ * Each test sets up the journal state it needs and checks the results, reporting every failed
+ * check with its line. The files are written into the directory given as the only argument
+ * (the current one by default) and removed at the end.
+ *
+ *     sse-journal-tests [DIR]
+ *
+ * The exit code is the number of failed tests.
+ */
+
+#include "sse-journal.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wformat="
+#  pragma GCC diagnostic ignored "-Wformat-extra-args"
+#  include <nlohmann/json.hpp>
+#  pragma GCC diagnostic pop
+#endif
+
+//--------------------------------------------------------------------------------------------------
+
+/// Failed checks of the running test
+static int failed = 0;
+
+static void
+check (bool ok, const char* what, int line)
+{
+    if (ok)
+        return;
+    std::cerr << "  line " << line << ": " << what << std::endl;
+    ++failed;
+}
+
+#define CHECK(x) check ((x), #x, __LINE__)
+
+/// Where the files go, with a trailing separator
+static std::string dir;
+
+//--------------------------------------------------------------------------------------------------
+
+/// Pages with the given titles and contents, as a freshly loaded book
+
+static void
+make_book (std::vector<std::pair<std::string, std::string>> const& texts)
+{
+    journal.pages.clear ();
+    for (auto const& [title, content]: texts)
+    {
+        page_t p {};
+        p.title = title;
+        p.content = content;
+        journal.pages.push_back (std::move (p));
+    }
+    journal.current_page = 0;
+    book_replaced ();
+}
+
+static std::vector<std::pair<std::string, std::string>>
+book_texts ()
+{
+    std::vector<std::pair<std::string, std::string>> texts;
+    for (std::size_t i = 0; i < journal.pages.size (); ++i)
+        texts.emplace_back (std::string (journal.pages[i].title.view ()),
+                            std::string (page_content (i)));
+    return texts;
+}
+
+static void
+wait_for_save ()
+{
+    while (book_save_status () == save_status::saving)
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+}
+
+static void
+remove_book (std::string const& file)
+{
+    std::remove (file.c_str ());
+    std::remove (edit_log_file (file).c_str ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The same calls for the writer as the document has values
+
+static void
+write_json (json_writer& w, nlohmann::json const& j)
+{
+    if (j.is_object ())
+    {
+        w.begin_object ();
+        for (auto const& kv: j.items ())
+        {
+            w.key (kv.key ());
+            write_json (w, kv.value ());
+        }
+        w.end_object ();
+    }
+    else if (j.is_array ())
+    {
+        w.begin_array ();
+        for (auto const& v: j)
+            write_json (w, v);
+        w.end_array ();
+    }
+    else if (j.is_string ()) w.value (j.get<std::string> ());
+    else if (j.is_boolean ()) w.value (j.get<bool> ());
+    else if (j.is_number_unsigned ()) w.value (j.get<unsigned long long> ());
+    else if (j.is_number_integer ()) w.value (j.get<long long> ());
+    else w.value (j.get<double> ());
+}
+
+static void
+test_json_writer ()
+{
+    auto j = nlohmann::json::parse (R"({
+        "text": "quote \" backslash \\ new line \n tab \t bell \u0007 Довакин ドラゴン",
+        "numbers": [0, -42, 18446744073709551615, 0.1, 1.0, -2.5e-8, 1e300, 3.4028234663852886e38],
+        "flags": { "yes": true, "no": false },
+        "empty object": {},
+        "empty array": [],
+        "nested": [[], [{}], { "a": [1, { "b": "c" }] }]
+    })");
+    for (auto style: { json_writer::style::pretty, json_writer::style::compact })
+    {
+        std::ostringstream os;
+        json_writer w (os, style);
+        write_json (w, j);
+        w.flush ();
+        CHECK (os.str () == j.dump (style == json_writer::style::pretty ? 4 : -1));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+test_book_formats ()
+{
+    std::vector<std::pair<std::string, std::string>> texts = {
+        { "First", "Some text\nover two lines" },
+        { "", "" },
+        { "Довакин", "ドラゴン \"quoted\" \\ \t tabbed" },
+        { "Last", std::string (100000, 'x') }
+    };
+    for (auto ext: { ".json", ".jbook", ".cbor", ".msgpack" })
+    {
+        auto file = dir + "tests-book" + ext;
+        make_book (texts);
+        journal.current_page = 2;
+        CHECK (save_book (file));
+        make_book ({ { "other", "book" }, { "", "" } });
+        CHECK (load_book (file));
+        CHECK (book_texts () == texts);
+        CHECK (journal.current_page == 2);
+        make_book ({ { "", "" }, { "", "" } });
+        remove_book (file);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Snapshots share the page texts, and keep them as they were when the pages are edited after
+
+static void
+test_snapshot ()
+{
+    make_book ({ { "Title", "Some text" }, { "", "" } });
+    auto book = snapshot_book ();
+    CHECK (book->pages[0].content.view.data () == journal.pages[0].content.c_str ());
+
+    touch_page (0).content += ", and more";
+    page_edited (0);
+    journal.pages[0].title = "Other";
+    page_edited (0);
+    CHECK (book->pages[0].title.view == "Title");
+    CHECK (book->pages[0].content.view == "Some text");
+    CHECK (journal.pages[0].content.view () == "Some text, and more");
+
+    auto again = snapshot_book ();
+    CHECK (again->pages[0].title.view == "Other");
+    CHECK (again->pages[0].content.view.data () == journal.pages[0].content.c_str ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The rows of the edited titles follow, also after the pages moved or the book was replaced
+
+static void
+test_chapters ()
+{
+    make_book ({ { "a", "" }, { " ", "" }, { "c", "" } });
+    auto blanks = [] {
+        std::vector<bool> b;
+        for (auto const& c: chapter_list ())
+            b.push_back (c.blank);
+        return b;
+    };
+    CHECK (blanks () == std::vector<bool> ({ false, true, false }));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        journal.pages[0].title = i % 2 ? "a" : "";
+        page_edited (0);
+    }
+    journal.pages[1].title = "b";
+    page_edited (1);
+    CHECK (blanks () == std::vector<bool> ({ true, false, false }));
+
+    erase_page (0);
+    journal.pages[1].title = "";
+    page_edited (1);
+    CHECK (blanks () == std::vector<bool> ({ false, true }));
+
+    journal.pages[0].title = "";
+    page_edited (0);
+    make_book ({ { "x", "" }, { "y", "" } });
+    CHECK (blanks () == std::vector<bool> ({ false, false }));
+    CHECK (chapter_list ("Y").size () == 1 && chapter_list ("Y")[0].page == 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static std::vector<search_hit_t> search (std::string const& query);
+
+/// Saving over the mapped book while the worker indexes and searches it
+
+static void
+test_jbook_overwrite ()
+{
+    auto file = dir + "tests-mapped.jbook";
+    std::vector<std::pair<std::string, std::string>> texts;
+    for (int i = 0; i < 20000; ++i)
+        texts.emplace_back ("page " + std::to_string (i), std::string (2000, 'a' + i % 26));
+    texts.back ().second = "the dragon sleeps";
+    make_book (texts);
+    CHECK (save_book (file));
+    CHECK (load_book (file));
+
+    std::vector<search_hit_t> hits;
+    search_async ("dragon");
+    auto start = std::chrono::steady_clock::now ();
+    CHECK (save_book (file));
+    CHECK (std::chrono::steady_clock::now () - start < std::chrono::milliseconds (500));
+    CHECK (wait_unmapped (file, 0));
+
+    // The cancelled query is run again
+    while (!take_search_results (hits))
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    CHECK (hits.size () == 1 && hits[0].page + 1 == texts.size ());
+    CHECK (search ("dragon").size () == 1);
+    CHECK (load_book (file));
+    CHECK (book_texts () == texts);
+
+    make_book ({ { "", "" }, { "", "" } });
+    remove_book (file);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+test_edit_log ()
+{
+    auto file = dir + "tests-log.json";
+    journal.edit_log = true;
+
+    make_book ({ { "a", "one" }, { "b", "two" }, { "c", "three" } });
+    CHECK (save_book (file));
+
+    touch_page (1).content = "two, edited";
+    page_edited (1);
+    insert_page (3);
+    touch_page (3).title = "d";
+    touch_page (3).content = "four";
+    page_edited (3);
+    erase_page (0);
+    auto expected = book_texts ();
+
+    auto size = std::ifstream (file, std::ios::binary | std::ios::ate).tellg ();
+    save_book_async (file);
+    wait_for_save ();
+    CHECK (book_save_status () == save_status::idle);
+    // Only the changes went out, into the log
+    CHECK (std::ifstream (file, std::ios::binary | std::ios::ate).tellg () == size);
+    CHECK (std::ifstream (edit_log_file (file)).is_open ());
+
+    make_book ({ { "", "" }, { "", "" } });
+    CHECK (load_book (file));
+    CHECK (book_texts () == expected);
+
+    // As at start, the log replayed is kept, so the next save appends to it too
+    make_book ({ { "", "" }, { "", "" } });
+    load_default_book (file);
+    CHECK (book_texts () == expected);
+    auto log_size = std::ifstream (edit_log_file (file), std::ios::binary | std::ios::ate).tellg ();
+    touch_page (0).content = "two, edited again";
+    page_edited (0);
+    save_book_async (file);
+    wait_for_save ();
+    CHECK (std::ifstream (file, std::ios::binary | std::ios::ate).tellg () == size);
+    CHECK (std::ifstream (edit_log_file (file), std::ios::binary | std::ios::ate).tellg ()
+            > log_size);
+
+    // A book padded to two pages is written whole on the next save, the padding not being logged
+    {
+        std::ofstream of (file);
+        of << R"({"current":0,"pages":{"0":{"title":"a","content":"one"}},)"
+              R"("version":{"major":1,"minor":5,"patch":0}})";
+    }
+    std::remove (edit_log_file (file).c_str ());
+    CHECK (load_book (file));
+    CHECK (journal.pages.size () == 2);
+    touch_page (1).content = "padded";
+    page_edited (1);
+    save_book_async (file);
+    wait_for_save ();
+    make_book ({ { "", "" }, { "", "" } });
+    CHECK (load_book (file));
+    CHECK (page_content (1) == "padded");
+
+    journal.edit_log = false;
+    remove_book (file);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+test_word_wrap ()
+{
+    CHECK (greedy_word_wrap ("aaa bbb ccc ddd", 8) == "aaa bbb\nccc ddd");
+    CHECK (greedy_word_wrap ("aaa bbb ccc ddd", 80) == "aaa bbb ccc ddd");
+    // New lines restart the count, too long words are left as they are
+    CHECK (greedy_word_wrap ("aa\nbbb ccc", 5) == "aa\nbbb\nccc");
+    CHECK (greedy_word_wrap ("abcdefghij kl", 4) == "abcdefghij\nkl");
+    CHECK (greedy_word_wrap ("", 10).empty ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+test_game_time ()
+{
+    auto format = "%h:%m:%s %ld (%sd), day %md of %lm (%bm, %am), %Y, %ri";
+    auto expected = "9:0:0 Fredas (Fre), day 29 of Last Seed (The Warrior, Thtithil (Egg)), "
+                    "4E201, 240";
+    CHECK (game_time (format, 12.375f) == expected);
+
+    format_program program;
+    std::string out;
+    compile_game_time (program, format);
+    game_time (out, program, 12.375f);
+    CHECK (out == expected);
+    CHECK (game_time ("%r", 0.5f) == "0.500000");
+    CHECK (game_time ("100% %x %", 1.f) == "100% %x %");
+    CHECK (game_time ("%h", -1.f) == "(n/a)");
+
+    // The key changes with the shown minute, or with any change if the seconds are shown
+    std::string a, b;
+    compile_game_time (program, "%h:%m");
+    game_time_inputs (a, program, 12.375f);
+    game_time_inputs (b, program, 12.375f + 1e-5f);
+    CHECK (a == b);
+    b.clear ();
+    game_time_inputs (b, program, 12.375f + 1.5f / (24 * 60));
+    CHECK (a != b);
+    compile_game_time (program, "%s");
+    a.clear ();
+    b.clear ();
+    game_time_inputs (a, program, 12.375f);
+    game_time_inputs (b, program, 12.375f + 1e-5f);
+    CHECK (a != b);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+wait_for_index ()
+{
+    while (index_busy ())
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+}
+
+static void
+test_find_page ()
+{
+    // Scanned while the worker indexes the book, and the same once it has
+    make_book ({ { "a", "nothing" }, { "b", "the dragon sleeps" }, { "c", "Довакин returns" } });
+    for (int indexed = 0; indexed < 2; ++indexed)
+    {
+        CHECK (find_page ("dragon") == 1);
+        CHECK (find_page ("DRAGON") == 3);
+        CHECK (find_page ("Довакин") == 2);
+        CHECK (find_page ("missing") == journal.pages.size ());
+        CHECK (find_page ("he") == 1);
+        wait_for_index ();
+    }
+
+    // Edited pages are found before the worker indexes them again
+    touch_page (0).content = "a dragon too";
+    page_edited (0);
+    CHECK (find_page ("dragon") == 0);
+    insert_page (0);
+    touch_page (0).title = "sleeps";
+    page_edited (0);
+    CHECK (find_page ("sleeps") == 0);
+    CHECK (find_page ("returns") == 3);
+    wait_for_index ();
+    CHECK (find_page ("sleeps") == 0);
+    CHECK (find_page ("returns") == 3);
+    erase_page (0);
+    CHECK (find_page ("sleeps") == 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static std::vector<search_hit_t>
+search (std::string const& query)
+{
+    std::vector<search_hit_t> hits;
+    search_async (query);
+    while (!take_search_results (hits))
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    return hits;
+}
+
+static void
+test_search ()
+{
+    make_book ({ { "a", "nothing" }, { "Dragon", "the dragon sleeps" }, { "c", "dragons return" } });
+    auto hits = search ("DRAGON sleep");
+    CHECK (hits.size () == 1 && hits[0].page == 1 && hits[0].matches == 8 + 1 + 1);
+    CHECK (hits.size () == 1 && hits[0].snippet == "the dragon sleeps");
+
+    // Edited right before, so the worker indexes the page first
+    touch_page (0).content = "dragon, dragon, dragon sleeps";
+    page_edited (0);
+    hits = search ("dragon sleep");
+    CHECK (hits.size () == 2 && hits[0].page == 1 && hits[1].page == 0);
+    CHECK (search ("dragon missing").empty ());
+    CHECK (search ("re").size () == 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Frames of about 2 ms, each counted once in the histogram of the frame times
+
+static void
+test_profiler ()
+{
+    enable_profiler (true);
+    for (int i = 0; i < 5; ++i)
+    {
+        profile_frame ();
+        std::this_thread::sleep_for (std::chrono::milliseconds (2));
+    }
+    enable_profiler (false);
+
+    // The first frame has no start yet
+    auto histogram = profile_histogram ("frame", 1, 50);
+    float frames = 0;
+    for (auto n: histogram)
+        frames += n;
+    CHECK (histogram.size () == 50 && frames == 4);
+    CHECK (histogram[0] == 0 && histogram[1] == 0);
+    CHECK (profile_histogram ("frame", 1000, 1) == std::vector<float> { 4 });
+    CHECK (profile_histogram ("none", 1, 50) == std::vector<float> (50, 0.f));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+test_commands ()
+{
+    make_book ({ { "a", "one" }, { "b", "two" }, { "c", "three" } });
+    CHECK (post_command (command_kind::append, "1\n, more"));
+    CHECK (post_command (command_kind::append, "\n, last"));
+    CHECK (post_command (command_kind::goto_page, "2"));
+    CHECK (!post_command (command_kind::goto_page, "two"));
+    CHECK (!post_command (command_kind (42), "x"));
+    CHECK (run_commands (16));
+    CHECK (page_content (1) == "two, more");
+    CHECK (page_content (2) == "three, last");
+    CHECK (journal.current_page == 1);
+
+    CHECK (post_command (command_kind::new_entry, "Title\nText"));
+    CHECK (post_command (command_kind::find, "more"));
+    CHECK (run_commands (16));
+    CHECK (journal.pages.size () == 4);
+    CHECK (journal.pages[3].title.view () == "Title" && page_content (3) == "Text");
+    CHECK (journal.current_page == 1);
+
+    command_kind kind;
+    CHECK (message_command ("any-mod", command_message_base + 3, kind)
+            && kind == command_kind::append);
+    CHECK (message_command ("sse-maptrack", 1, kind) && kind == command_kind::find);
+    CHECK (!message_command ("any-mod", 1, kind));
+    CHECK (!message_command ("sse-maptrack", 5, kind));
+    CHECK (!message_command ("any-mod", command_message_base, kind));
+    CHECK (!message_command ("any-mod", command_message_base + 5, kind));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+test_placeholders ()
+{
+    variable_t v;
+    v.deletable = false;
+    v.fuid = 1;
+    v.name = "Var";
+    v.apply = [] (variable_t* self) { self->output = "out"; };
+    auto saved = std::move (journal.variables);
+    journal.variables.clear ();
+    journal.variables.push_back (std::move (v));
+
+    std::string out;
+    expand_placeholders (out, "a {{Var}} b {{Other}} {{{{Var}}}} {{");
+    CHECK (out == "a out b {{Other}} {{out}} {{");
+    CHECK (!has_placeholders ("{Var}"));
+
+    make_book ({ { "a", "at {{Var}}" }, { "b", "none" } });
+    CHECK (freeze_placeholders () == 1);
+    CHECK (page_content (0) == "at out");
+
+    journal.variables = std::move (saved);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+test_utf8 ()
+{
+    CHECK (valid_utf8 ("plain"));
+    CHECK (valid_utf8 ("Довакин ドラゴン 🐉"));
+    CHECK (!valid_utf8 ("\xC0\xAF"));
+    CHECK (!valid_utf8 ("\xE0\x80\x80"));
+    CHECK (!valid_utf8 ("\xED\xA0\x80"));
+    CHECK (!valid_utf8 ("abc\xF0\x9F"));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char** argv)
+{
+    dir = argc > 1 ? argv[1] : "";
+    if (!dir.empty () && dir.back () != '/' && dir.back () != '\\')
+        dir += '/';
+
+    static const std::vector<std::pair<const char*, void (*) ()>> tests = {
+        { "json_writer", test_json_writer },
+        { "book_formats", test_book_formats },
+        { "snapshot", test_snapshot },
+        { "jbook_overwrite", test_jbook_overwrite },
+        { "edit_log", test_edit_log },
+        { "chapters", test_chapters },
+        { "word_wrap", test_word_wrap },
+        { "game_time", test_game_time },
+        { "find_page", test_find_page },
+        { "search", test_search },
+        { "profiler", test_profiler },
+        { "commands", test_commands },
+        { "placeholders", test_placeholders },
+        { "utf8", test_utf8 },
+    };
+
+    int failures = 0;
+    for (auto const& [name, test]: tests)
+    {
+        failed = 0;
+        try
+        {
+            test ();
+        }
+        catch (std::exception const& ex)
+        {
+            std::cerr << "  exception: " << ex.what () << std::endl;
+            ++failed;
+        }
+        std::cerr << name << (failed ? " failed" : " ok") << std::endl;
+        failures += failed > 0;
+    }
+    return failures;
+}
+
+//--------------------------------------------------------------------------------------------------